@@ -4,9 +4,13 @@
 #include "nodes/graph_io.h"
 #include "onnx.pb.h"
 #include "options.h"
+#include "pass_timer.h"
 
 #include "aixlog.hpp"
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <queue>
 
 
 using namespace toC;
@@ -24,33 +28,68 @@ Graph::Graph(
 	processGraph(onnx_model, ext_inputs);
 }
 
+void Graph::optimize(void)
+{
+	// Constant folding is done already while resolving the nodes
+	if( options.opt_fold_batchnorm && options.quantize == false )
+		fold_batchnormalization();
+	if( options.opt_fuse_activations )
+		fuse_activations();
+	if( options.opt_fuse_elementwise && options.quantize == false )
+		fuse_elementwise();
+	if( options.opt_winograd && options.quantize == false )
+		winograd_convolutions();
+	if( options.opt_im2col && options.quantize == false )
+		im2col_convolutions();
+	if( options.opt_alias_views )
+		alias_view_nodes();
+	if( options.opt_inplace_concat )
+		inplace_concat();
+	if( options.opt_inplace_nodes )
+		inplace_nodes();
+	if( options.opt_schedule )
+		schedule_nodes();
+	if( options.opt_dedupe )
+		dedupe_tensors();
+	if( options.opt_arena )
+		plan_arena();
+	else if( options.opt_unionize )
+		unionize_tensors();
+}
+
 void Graph::processGraph(
 	onnx::ModelProto &onnx_model,
 	std::vector<Tensor*> ext_inputs
 	)
 {
-	onnx::GraphProto onnx_graph = onnx_model.graph();
+	PassTimer graph_timer("build graph");
+	const onnx::GraphProto &onnx_graph = onnx_model.graph();
 	Node::onnx_ir_version = onnx_ir_version();
 	// 0. add provided external initializers (from test bench
 	LOG(DEBUG) << "Adding external (testsuite) tensors." <<std::endl;
 	for( auto t : ext_inputs ) {
 		LOG(DEBUG) << "  - " << t->name <<std::endl;
 		tensors.push_back(t);
+		indexTensor(t);
 	}
 	LOG(TRACE) << "  (done adding external tensors)." <<std::endl;
 
 	// 1. add initializers as resolved tensors
 	// in case of quantization, make quantized copies here
 	LOG(DEBUG) << "Adding initialized constant tensors from .onnx file." <<std::endl;
-	for( auto i : onnx_graph.initializer() )
-		addInitializedTensor( i );
+	{
+		PassTimer timer("initializers");
+		for( const auto &i : onnx_graph.initializer() )
+			addInitializedTensor( i );
+		timer.set_items(onnx_graph.initializer_size());
+	}
 	LOG(TRACE) << "  (done adding initialized tensors)." <<std::endl;
 
 	// 2. add graph inputs as resolved tensors
 	// in case of quantization, convert all IO to INT8
 	addGraphInputMetanode();
 	LOG(DEBUG) << "Marking graph input tensors as IO." <<std::endl;
-	for ( auto i : onnx_graph.input() ) {
+	for ( const auto &i : onnx_graph.input() ) {
 		Tensor *n = getIoTensor( i );
 		n->isConst = true;
 		addTensor( n );
@@ -59,12 +98,16 @@ void Graph::processGraph(
 
 	// 3. Do the nodes
 	LOG(DEBUG) << "Resolving nodes." <<std::endl;
-	resolveGraphNodes(onnx_graph);
+	{
+		PassTimer timer("resolve nodes");
+		resolveGraphNodes(onnx_graph);
+		timer.set_items(onnx_graph.node_size());
+	}
 
 	// 4. Add the IO tag to those tensors the user wants back.
 	Node *graph_output_node = addGraphOutputMetanode();
 	LOG(DEBUG) << "Marking graph output tensors as IO." <<std::endl;
-	for ( auto o : onnx_graph.output() ) {
+	for ( const auto &o : onnx_graph.output() ) {
 		LOG(TRACE) << "\t- found graph output tensor '" << o.name() << "':" << std::endl;
 		Tensor *t = findTensor(o.name());
 		if( t == nullptr )
@@ -79,48 +122,77 @@ void Graph::processGraph(
 		graph_output_node->register_input(t, "");
 		LOG(TRACE) << "\t\t " << t->print_trace_dump() << std::endl;
 	}
+
+	if( options.opt_fold_constants )
+		remove_unused_folded_inputs();
+	graph_timer.set_items(nodes.size());
 }
 
-void Graph::resolveGraphNodes(onnx::GraphProto &onnx_graph)
+void Graph::resolveGraphNodes(const onnx::GraphProto &onnx_graph)
 {
-	/* A vast majority of ONNX graphs in the wild list their
+	/* Resolve the nodes in a topological order (Kahn's algorithm).
+	 * A vast majority of ONNX graphs in the wild list their
 	 * nodes in an order where they can be resolved in the
-	 * order they are listed in the onnx file.
-	 * This "brute force" search for resolvable nodes should
-	 * not affect speed at all in the normal case
-	 * "Optimize for speed" here that case. If the input graph
-	 * is big enough that this algorithm becomes a bottleneck,
-	 * then onnx2c probably isn't your best option anyway.
+	 * order they are listed in the onnx file. Ready nodes are
+	 * therefore picked lowest-file-index first, which keeps that
+	 * order (and the generated code) unchanged for sorted graphs,
+	 * and still resolves each node exactly once for unsorted ones.
 	 */
+	int num_nodes = onnx_graph.node_size();
+
+	// Which node produces which tensor
+	std::unordered_map<std::string, int> producer;
+	for( int i=0; i<num_nodes; i++ )
+		for( const auto &o : onnx_graph.node(i).output() )
+			if( o != "" )
+				producer.emplace(o, i);
+
+	// Count, for each node, the inputs that are still to be produced
+	// by some other node. Inputs that are already known tensors
+	// (initializers, graph inputs) don't count.
+	std::vector<unsigned> num_pending(num_nodes, 0);
+	std::vector<std::vector<int>> dependants(num_nodes);
+	for( int i=0; i<num_nodes; i++ ) {
+		for( const auto &in : onnx_graph.node(i).input() ) {
+			if( in == "" || findTensor(in) )
+				continue;
+			auto p = producer.find(in);
+			if( p == producer.end() ) {
+				LOG(DEBUG) << "Input tensor '" << in << "' is not produced by any node" << std::endl;
+				continue; // can never be resolved, caught below
+			}
+			num_pending[i]++;
+			dependants[p->second].push_back(i);
+		}
+	}
 
-	unsigned num_unresolved_prev_round;
-	unsigned num_unresolved = onnx_graph.node_size();
-
-	do {
-		num_unresolved_prev_round = num_unresolved;
-		num_unresolved = 0;
+	std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+	for( int i=0; i<num_nodes; i++ )
+		if( num_pending[i] == 0 )
+			ready.push(i);
 
-		for( onnx::NodeProto n : onnx_graph.node() ) {
-			bool res = tryResolveNode( n );
-			if( res == false )
-				num_unresolved++;
-		}
+	int num_resolved = 0;
+	while( ready.empty() == false ) {
+		int i = ready.top();
+		ready.pop();
 
-		// all done
-		if( num_unresolved == 0 )
+		if( tryResolveNode( onnx_graph.node(i) ) == false )
 			break;
+		num_resolved++;
 
-	// repeat as long as at least one new node got resolved
-	} while ( num_unresolved < num_unresolved_prev_round );
+		for( int d : dependants[i] )
+			if( --num_pending[d] == 0 )
+				ready.push(d);
+	}
 
-	if( num_unresolved != 0 )
+	if( num_resolved != num_nodes )
 		ERROR("Input ONNX graph is not resolvable.");
 }
 
 /* Add already resolved onnx::TensorProto. E.g. TensorProtos that
  * are resolved already in the ONNX model (inputs and initialized ones)
  */
-void Graph::addInitializedTensor(onnx::TensorProto &tensor)
+void Graph::addInitializedTensor(const onnx::TensorProto &tensor)
 {
 	Tensor *t = new Tensor;
 
@@ -136,16 +208,16 @@ void Graph::addInitializedTensor(onnx::TensorProto &tensor)
 	}
 }
 
-Tensor* Graph::getIoTensor(onnx::ValueInfoProto &vi)
+Tensor* Graph::getIoTensor(const onnx::ValueInfoProto &vi)
 {
-	onnx::TypeProto tp = vi.type();
+	const onnx::TypeProto &tp = vi.type();
 	onnx::TypeProto::ValueCase vc = tp.value_case();
 
 	if( vc != onnx::TypeProto::ValueCase::kTensorType )
 		ERROR("unimplemented graph input type");
 
-	onnx::TypeProto_Tensor tpt = tp.tensor_type();
-	onnx::TensorShapeProto tsp = tpt.shape();
+	const onnx::TypeProto_Tensor &tpt = tp.tensor_type();
+	const onnx::TensorShapeProto &tsp = tpt.shape();
 
 	Tensor *t = new Tensor;
 	t->initialize=false;
@@ -164,7 +236,7 @@ Tensor* Graph::getIoTensor(onnx::ValueInfoProto &vi)
 	if( options.quantize )
 		t->data_type = onnx::TensorProto_DataType_INT8;
 
-	for( onnx::TensorShapeProto_Dimension d : tsp.dim() ) {
+	for( const onnx::TensorShapeProto_Dimension &d : tsp.dim() ) {
 
 		// dim_param is a string that defines this dimension's variable name
 		// e.g. "N=1" or "batch_size". Seems to be used for variable size batches.
@@ -222,17 +294,15 @@ bool Graph::getNodeInputTensors(const onnx::NodeProto &node, toC::Node *onnx2c_n
 		}
 
 		LOG(TRACE) << "Looking for input tensor '" << i << "':" << std::endl;
-		for( auto t : tensors ) {
-			if ( t->name == i ) {
-				LOG(TRACE) << "\t- found input tensor '" << i << "':" << std::endl;
-				LOG(TRACE) << "\t\t " << t->print_trace_dump() << std::endl;
-				input_resolved = true;
-				// register node with local name "" - since we don't have node context here
-				// we don't know if it is named 'X', 'input', 'A' or whatever. Node resolver
-				// assigns that name.
-				onnx2c_node->register_input(t, "");
-				break;
-			}
+		Tensor *t = findTensor(i);
+		if( t ) {
+			LOG(TRACE) << "\t- found input tensor '" << i << "':" << std::endl;
+			LOG(TRACE) << "\t\t " << t->print_trace_dump() << std::endl;
+			input_resolved = true;
+			// register node with local name "" - since we don't have node context here
+			// we don't know if it is named 'X', 'input', 'A' or whatever. Node resolver
+			// assigns that name.
+			onnx2c_node->register_input(t, "");
 		}
 		LOG(TRACE) << "    finished looking" << std::endl;
 
@@ -251,17 +321,16 @@ bool Graph::getNodeInputTensors(const onnx::NodeProto &node, toC::Node *onnx2c_n
  * @return true node is (or was earlier) added to Graph::nodes datastructure.
  *          Return false if Graph::tensors does not yet have all the input tensor for this node.
  */
-bool Graph::tryResolveNode(onnx::NodeProto &onnx_node)
+bool Graph::tryResolveNode(const onnx::NodeProto &onnx_node)
 {
 	std::vector<Tensor*> inputs;
 	LOG(DEBUG) << "Resolving ONNX node: '" << onnx_node.name() << "'" <<std::endl;
 
 	// This check is needed in case the caller needs to iterate over the nodes more than once.
-	for( auto o : nodes )
-		if( onnx_node.name() == o->onnx_name ) {
-			LOG(TRACE) << "Node '" << onnx_node.name() << "' already resolved"<<std::endl;
-			return true;
-		}
+	if( findNodeByName(onnx_node.name()) ) {
+		LOG(TRACE) << "Node '" << onnx_node.name() << "' already resolved"<<std::endl;
+		return true;
+	}
 
 	// ONNX has a few nodes that have quantized alternatives.
 	// Switch to those here.
@@ -385,9 +454,15 @@ bool Graph::tryResolveNode(onnx::NodeProto &onnx_node)
 	}
 	LOG(TRACE) << "      (no more outputs)" << std::endl;
 
-	log_trace_all_tensors();
+	// Dumping all tensors after every node is quadratic in graph size,
+	// so only do the work when the trace output is actually wanted.
+	if( options.logging_level >= 4 )
+		log_trace_all_tensors();
 	n->isResolved = true;
+	if( options.opt_fold_constants && fold_constant_node(n) )
+		return true;
 	nodes.push_back(n);
+	indexNode(n);
 	return true;
 }
 
@@ -565,15 +640,11 @@ void Graph::addTensor(Tensor *t)
 	 * TODO: clean up
 	 */
 
-	Tensor *prev = NULL;  // pointer to the previously existing tensor. This gets updated
-	for( auto o : tensors)
-		if( t->name == o->name ) {
-			prev = o;
-			break;
-		}
+	Tensor *prev = findTensor(t->name);  // pointer to the previously existing tensor. This gets updated
 
 	if( prev == NULL ) {
 		tensors.push_back(t);
+		indexTensor(t);
 		LOG(DEBUG) << "New tensor: " << t->name << " - "<< t->data_type_str() << " { " << t->str_dimensions() << "}" << std::endl;
 		LOG(TRACE) << "    " << t->print_trace_dump();
 		// TODO return & remove else {}
@@ -622,10 +693,21 @@ void Graph::addTensor(Tensor *t)
 
 Tensor *Graph::findTensor(const std::string &name) const
 {
-	for( auto o : tensors)
-		if( o->name == name )
-			return o;
-	return NULL;
+	auto t = tensor_index.find(name);
+	if( t == tensor_index.end() )
+		return NULL;
+	return t->second;
+}
+
+void Graph::indexTensor(Tensor *t)
+{
+	// emplace() does not overwrite: first one of a name wins
+	tensor_index.emplace(t->name, t);
+}
+
+void Graph::indexNode(Node *n)
+{
+	node_index.emplace(n->onnx_name, n);
 }
 
 void Graph::replaceWithQuantized(std::vector<Tensor*> &inputs)
@@ -644,6 +726,7 @@ Node* Graph::addGraphInputMetanode()
 	n->isResolved = true;
 	n->onnx_name = "graph_input";
 	nodes.push_back(n);
+	indexNode(n);
 	return n;
 }
 
@@ -653,13 +736,111 @@ Node* Graph::addGraphOutputMetanode()
 	n->isResolved = true;
 	n->onnx_name = "graph_output";
 	nodes.push_back(n);
+	indexNode(n);
 	return n;
 }
 
 Node* Graph::findNodeByName( const std::string node_name )
 {
-	for( auto n : nodes )
-		if( n->onnx_name == node_name )
-			return n;
-	return nullptr;
+	auto n = node_index.find(node_name);
+	if( n == node_index.end() )
+		return nullptr;
+	return n->second;
+}
+
+void Graph::merge_into_producer(Node *n, Node *producer)
+{
+	Tensor *x = n->get_input_tensor(0);
+	producer->replace_output(0, n->get_output_tensor(0));
+
+	for( unsigned i=1; i<n->get_number_of_inputs(); i++ ) {
+		Tensor *t = n->get_input_tensor(i);
+		auto &c = t->consumers;
+		c.erase(std::remove(c.begin(), c.end(), n), c.end());
+		if( c.size() == 0 && t->isIO == false )
+			t->generate = false;
+	}
+	tensors.erase(std::find(tensors.begin(), tensors.end(), x));
+	if( findTensor(x->name) == x )
+		tensor_index.erase(x->name);
+	if( findNodeByName(n->onnx_name) == n )
+		node_index.erase(n->onnx_name);
+	nodes.erase(std::find(nodes.begin(), nodes.end(), n));
+	delete n;
+	delete x;
+}
+
+Tensor* Graph::alias_root(Tensor *t)
+{
+	while( t->isAliasOf )
+		t = t->isAliasOf;
+	return t;
+}
+
+bool Graph::is_intermediate(const Tensor *t)
+{
+	return t->is_used()
+	    && t->isIO == false
+	    && t->isConst == false
+	    && t->initialize == false
+	    && t->isRecursive == false;
+}
+
+bool Graph::is_modifiable_constant(const Tensor *t, const Node *n)
+{
+	return t->isConst
+	    && t->initialize
+	    && t->isIO == false
+	    && t->data_buffer != nullptr
+	    && t->data_type == onnx::TensorProto_DataType_FLOAT
+	    && t->consumers.size() == 1
+	    && t->consumers[0] == n;
+}
+
+void Graph::replace_constant_data(Tensor *t, void *data, const std::vector<int> &dims)
+{
+	// The old buffer can be a part of the external data,
+	// so it is not freed
+	t->data_buffer = data;
+	t->data_dim = dims;
+}
+
+std::vector<TensorLifetime> Graph::intermediate_lifetimes(void) const
+{
+	std::unordered_map<const Tensor*, unsigned> index;
+	std::vector<TensorLifetime> lifetimes;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		nodes[i]->forEachOutput([&index, &lifetimes, i](Tensor *o) {
+			// Aliases are calculated into the tensor they are a view into
+			o = alias_root(o);
+			if( is_intermediate(o) == false || index.find(o) != index.end() )
+				return;
+			index[o] = lifetimes.size();
+			lifetimes.push_back({o, i, i});
+		});
+	}
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		for( unsigned j=0; j<nodes[i]->get_number_of_inputs(); j++ ) {
+			auto p = index.find(alias_root(nodes[i]->get_input_tensor(j)));
+			if( p != index.end() )
+				lifetimes[p->second].last = std::max(lifetimes[p->second].last, i);
+		}
+	}
+	return lifetimes;
+}
+
+uint64_t Graph::peak_bytes(const std::vector<TensorLifetime> &lifetimes)
+{
+	unsigned num_steps = 0;
+	for( auto &l : lifetimes )
+		num_steps = std::max(num_steps, l.last + 1);
+	uint64_t peak = 0;
+	for( unsigned i=0; i<num_steps; i++ ) {
+		uint64_t live = 0;
+		for( auto &l : lifetimes )
+			if( l.first <= i && i <= l.last )
+				live += (uint64_t)l.t->data_num_elem() * l.t->data_elem_size();
+		peak = std::max(peak, live);
+	}
+	return peak;
 }
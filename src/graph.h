@@ -4,12 +4,25 @@
 #include "node.h"
 #include "tensor.h"
 
+#include <functional>
+#include <unordered_map>
+
 /* Command line options */
 extern bool quantize;
 extern bool target_avr;
 
 namespace toC {
 
+/* The indexes (into Graph::nodes) of the first and the last
+ * node that calculate or use tensor 't' */
+struct TensorLifetime {
+	Tensor *t;
+	unsigned first;
+	unsigned last;
+};
+
+class BatchNormalization;
+
 class Graph {
 public:
 	Graph(
@@ -20,6 +33,9 @@ public:
 	/* print the entire .h and .cc file contents */
 	void print_header(std::ostream &destination);
 	void print_source(std::ostream &destination);
+	/* Print a report of the memory and calculations as JSON,
+	 * instead of the source. See graph_report.cc */
+	void print_report_json(std::ostream &dst);
 
 	/* print individual parts of the file */
 	void print_file_frontmatter(std::ostream &destination);
@@ -27,26 +43,107 @@ public:
 	void print_tensor(const Tensor *, std::ostream &dst);
 	void print_functions(std::ostream &destination);
 	void print_includes(std::ostream &dst);
+	void print_node_hooks(std::ostream &dst);
 	void print_interface_function(std::ostream &dst, bool print_definition=true);
 
+	/* Call print_item(i, stream) for items 0..num_items-1, so that their
+	 * output ends up in 'dst' in order. With options.jobs > 1 the items
+	 * are printed in parallel, so print_item must not modify the graph. */
+	void print_in_parallel(std::ostream &dst, unsigned num_items, std::function<void(unsigned, std::ostream&)> print_item);
+
 	/* Create the onnx2c graph elements from the ONNX graph */
 	void processGraph(
 		onnx::ModelProto &onnx_model,
 		std::vector<Tensor*> inputs={}
 	);
-	void resolveGraphNodes(onnx::GraphProto &onnx_graph);
+	void resolveGraphNodes(const onnx::GraphProto &onnx_graph);
+
+	/* Run the optimization passes enabled in the options,
+	 * in the order they need to be run. */
+	void optimize(void);
 
 	/* Optimization step: cluster the buffers of intermediate tensors into
 	 * unions. This make the memory buffers time shared. */
 	void unionize_tensors(void);
 
-	void addInitializedTensor(onnx::TensorProto &tensor);
-	Tensor* getIoTensor(onnx::ValueInfoProto &vi);
+	/* Optimization step: an alternative to unionize_tensors. Place
+	 * the intermediate tensors at offsets in one static arena, so
+	 * that tensors in use at the same time don't overlap. */
+	void plan_arena(void);
+
+	/* Optimization step: make constant tensors with identical contents
+	 * aliases of one of them, so only one copy gets generated. */
+	void dedupe_tensors(void);
+
+	/* Optimization step: evaluate nodes whose inputs are all compile
+	 * time constants, and make their outputs initialized tensors.
+	 * Called for each node as it gets resolved. Returns true if
+	 * the node was folded, and should not be added to the graph. */
+	bool fold_constant_node(Node *n);
+	void remove_unused_folded_inputs(void);
+
+	/* Optimization step: fold BatchNormalization nodes into the
+	 * weights and bias of the Conv, ConvTranspose, Gemm or MatMul
+	 * node before them, and remove the BatchNormalization nodes. */
+	void fold_batchnormalization(void);
+
+	/* Optimization step: fuse activation functions (Relu, Clip,...)
+	 * into the Conv, ConvInteger, Gemm or MatMul node before them, so
+	 * they get applied when the output is stored. The activation nodes
+	 * are removed. */
+	void fuse_activations(void);
+
+	/* Optimization step: replace groups of elementwise nodes, where
+	 * the results of the nodes are only used in the group, with a
+	 * FusedElementwise node that calculates them all in a single loop. */
+	void fuse_elementwise(void);
+
+	/* Optimization step: calculate the Conv nodes where it pays off,
+	 * and the scratch buffer fits in options.scratch_ram, by copying
+	 * the input patches into a buffer and multiplying the weights
+	 * with it, instead of the direct convolution loops. */
+	void im2col_convolutions(void);
+
+	/* Optimization step: calculate the 3x3, stride 1 Conv nodes with
+	 * the Winograd transform, in tiles of outputs, where the scratch
+	 * buffers fit in options.scratch_ram. */
+	void winograd_convolutions(void);
+
+	/* Optimization step: make the outputs of nodes that only change
+	 * the shape of their input (e.g. Reshape) aliases of the input,
+	 * and remove the nodes. */
+	void alias_view_nodes(void);
+
+	/* Optimization step: make the inputs of Concat nodes aliases
+	 * of their part of the output, where possible, so the inputs
+	 * get calculated in place instead of copied. */
+	void inplace_concat(void);
+
+	/* Optimization step: have Relu, Clip, BatchNormalization, Softmax
+	 * and elementwise nodes write their output over their input,
+	 * when nothing else needs the input afterwards. */
+	void inplace_nodes(void);
+
+	/* Optimization step: reorder the nodes, within the order their
+	 * inputs need, so that less memory is needed for the intermediate
+	 * tensors at the same time. */
+	void schedule_nodes(void);
+
+	/* Write the constant tensors' data into a binary file. After this,
+	 * the printed source refers to the tensors as offsets into that
+	 * file's contents, instead of printing initializers for them.
+	 * With 'runtime_loaded', the file gets a header, and the source
+	 * an entry_init() function to pass the file contents in at run time.
+	 * Otherwise the file is compiled in with the source. */
+	void write_weights_blob(const std::string &filename, bool runtime_loaded=false);
+
+	void addInitializedTensor(const onnx::TensorProto &tensor);
+	Tensor* getIoTensor(const onnx::ValueInfoProto &vi);
 
 	void replaceWithQuantized(std::vector<Tensor*> &inputs);
 	bool getNodeInputTensors(const onnx::NodeProto &node, toC::Node *inputs);
 
-	bool tryResolveNode(onnx::NodeProto &node);
+	bool tryResolveNode(const onnx::NodeProto &node);
 	bool hasUnresolvedNodes(void);
 	Node* createNode(std::string opName);
 
@@ -62,6 +159,16 @@ private:
 	std::vector<Node*> nodes;
 	Node* findNodeByName( const std::string node_name );
 
+	// Lookup tables into the above two vectors, keyed by the ONNX name.
+	// The vectors keep the order (of creation/resolving), these make
+	// finding by name O(1) so big graphs don't compile in quadratic time.
+	// When several tensors share a name (e.g. the unnamed "" tensors),
+	// the table points to the first one added, like a linear search would.
+	std::unordered_map<std::string, Tensor*> tensor_index;
+	std::unordered_map<std::string, Node*> node_index;
+	void indexTensor(Tensor *t);
+	void indexNode(Node *n);
+
 	// Should onnx2c print debug info while compiling
 	bool verbose_mode;
 
@@ -92,6 +199,60 @@ private:
 	std::vector<Tensor *> tensor_unions;
 	uint32_t add_to_free_union(Tensor *t);
 	void mark_union_unoccupied(uint32_t);
+
+	// For the arena memory planner: the byte offset of each
+	// tensor in the arena, the size of the arena, and the most
+	// bytes the tensors need at the same time.
+	std::unordered_map<const Tensor*, uint64_t> arena_offsets;
+	uint64_t arena_size = 0;
+	uint64_t arena_lower_bound = 0;
+
+	// For the tensor deduplication: the bytes of flash the
+	// duplicates would have taken, for the report
+	uint64_t deduped_bytes = 0;
+
+	// For the constant folding: the inputs of the folded nodes
+	// (might not be needed anymore), and how many were folded.
+	std::vector<Tensor*> folded_node_inputs;
+	unsigned num_folded_nodes = 0;
+
+	// For the BatchNormalization folding
+	bool fold_batchnormalization_into(BatchNormalization *bn, Node *prev);
+	Tensor* add_folded_bias(Node *n, const std::string &name, const std::vector<int> &dims);
+
+	/* Remove node 'n', whose calculation has been merged into 'producer',
+	 * the node that calculates n's first input. 'producer' gets n's output,
+	 * and the tensor between the two is deleted along with 'n'. */
+	void merge_into_producer(Node *n, Node *producer);
+
+	/* The tensor whose memory 't' is in, following isAliasOf */
+	static Tensor* alias_root(Tensor *t);
+	/* Is 't' an intermediate tensor, i.e. calculated by a node and
+	 * needed only while entry() runs. These are the tensors the memory
+	 * planning passes place, when calculated by a node. */
+	static bool is_intermediate(const Tensor *t);
+	/* Is 't' a float constant that only 'n' uses, so that the
+	 * optimization passes can change it for 'n' */
+	static bool is_modifiable_constant(const Tensor *t, const Node *n);
+	/* Replace the data of the constant 't' with 'data', of shape 'dims' */
+	static void replace_constant_data(Tensor *t, void *data, const std::vector<int> &dims);
+	/* The lifetimes of the intermediate tensors that nodes calculate
+	 * (following aliases to their roots), in the order the tensors
+	 * are first calculated. And the most bytes of them in use at the
+	 * same time. */
+	std::vector<TensorLifetime> intermediate_lifetimes(void) const;
+	static uint64_t peak_bytes(const std::vector<TensorLifetime> &lifetimes);
+
+	// For the binary weights blob: the file name, and where in
+	// the file each of the tensors that are written there is.
+	std::string weights_blob_file;
+	bool weights_blob_runtime = false;
+	uint64_t weights_blob_size = 0;
+	uint64_t weights_layout_hash = 0;
+	std::unordered_map<const Tensor*, uint64_t> weights_blob_offsets;
+	bool goes_to_weights_blob(const Tensor *t) const;
+	void print_weights_blob(std::ostream &dst);
+	void print_weights_init_function(std::ostream &dst);
 };
 
 }
@@ -4,9 +4,14 @@
 #include "error.h"
 #include "graph.h"
 #include "options.h"
+#include "pass_timer.h"
 #include "util.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 using namespace toC;
 
@@ -17,14 +22,27 @@ void Graph::print_header(std::ostream &dst)
 
 void Graph::print_source(std::ostream &dst)
 {
+	PassTimer timer("print source");
 	print_file_frontmatter(dst);
 	dst << std::endl;
 	print_includes(dst);
 	dst << std::endl;
-	print_global_tensors(dst);
+	{
+		PassTimer timer("global tensors");
+		print_global_tensors(dst);
+		timer.set_items(tensors.size());
+	}
 	dst << std::endl;
-	print_functions(dst);
+	{
+		PassTimer timer("node functions");
+		print_functions(dst);
+		timer.set_items(nodes.size());
+	}
 	dst << std::endl;
+	if( options.node_hooks ) {
+		print_node_hooks(dst);
+		dst << std::endl;
+	}
 	print_interface_function(dst);
 }
 
@@ -59,6 +77,42 @@ void Graph::print_tensor(const Tensor *t, std::ostream &dst)
 		return;
 	}
 
+	if( t->isAliasOf ) {
+		// Refer to the aliased tensor instead. If the shapes differ,
+		// cast the other tensor's memory to this tensor's type.
+		// The other tensor can be a parameter of entry(), i.e. a pointer,
+		// so cast what it decays to, instead of taking its address.
+		const Tensor *orig = t->isAliasOf;
+		dst << "#define " << t->cname() << " ";
+		if( t->alias_offset == 0 && orig->data_dim == t->data_dim && orig->data_type == t->data_type )
+			dst << orig->print_tensor_callsite() << std::endl;
+		else if( t->alias_offset == 0 )
+			dst << "(*(" << t->print_tensor("(*)", false, t->isConst) << ")" << orig->print_tensor_callsite() << ")" << std::endl;
+		else {
+			// A part of the other tensor, e.g. one input of an in-place Concat
+			dst << "(*(" << t->print_tensor("(*)", false, t->isConst) << ")";
+			dst << "((" << orig->data_type_str() << "*)" << orig->print_tensor_callsite() << " + " << t->alias_offset << "))" << std::endl;
+		}
+		return;
+	}
+
+	auto blob_entry = weights_blob_offsets.find(t);
+	if( blob_entry != weights_blob_offsets.end() ) {
+		// A view into the weights blob, with the type of the tensor.
+		// E.g. "#define tensor_W (*(const float (*)[3][4])(onnx2c_weights + 128))"
+		dst << "#define " << t->cname() << " (*(" << t->print_tensor("(*)", false, true) << ")";
+		dst << "(onnx2c_weights + " << blob_entry->second << "))" << std::endl;
+		return;
+	}
+
+	auto arena_entry = arena_offsets.find(t);
+	if( arena_entry != arena_offsets.end() ) {
+		// A view into the arena, like for the weights blob
+		dst << "#define " << t->cname() << " (*(" << t->print_tensor("(*)", false, false) << ")";
+		dst << "(onnx2c_arena.bytes + " << arena_entry->second << "))" << std::endl;
+		return;
+	}
+
 	if( t->union_no < 0 )
 		dst << "static ";
 
@@ -74,25 +128,39 @@ void Graph::print_tensor(const Tensor *t, std::ostream &dst)
 
 void Graph::print_global_tensors(std::ostream &dst)
 {
+	if( weights_blob_file != "" )
+		print_weights_blob(dst);
+
+	if( arena_size > 0 ) {
+		dst << "/* The intermediate tensors, at offsets where the tensors used" << std::endl;
+		dst << " * at the same time don't overlap. " << arena_size << " bytes, of which at most" << std::endl;
+		dst << " * " << arena_lower_bound << " are in use at the same time. */" << std::endl;
+		dst << "static union {" << std::endl;
+		dst << "\tuint8_t bytes[" << arena_size << "];" << std::endl;
+		dst << "\tlong double align;" << std::endl;
+		dst << "} onnx2c_arena;" << std::endl << std::endl;
+	}
+
 	// ununionized tensors
 	LOG(TRACE) << "printing global tensors - ununionized " << std::endl;
-	for( auto t : tensors )
-	{
+	print_in_parallel(dst, tensors.size(), [this](unsigned i, std::ostream &buf) {
+		const Tensor *t = tensors[i];
 		LOG(TRACE) << "\t" << t->print_trace_dump() << std::endl;
 		if( t->union_no < 0
 		 && t->generate)
-			print_tensor(t, dst);
-	}
+			print_tensor(t, buf);
+	});
 
 	LOG(TRACE) << "printing global tensors - unionized " << std::endl;
+	std::vector<std::vector<const Tensor*>> union_members(tensor_unions.size());
+	for( auto t : tensors )
+		if( t->union_no >= 0 )
+			union_members[t->union_no].push_back(t);
 	for( unsigned u=0; u<tensor_unions.size(); u++ )
 	{
 		dst << "union tensor_union_" << u << " {" << std::endl;
-		for( auto t : tensors )
-		{
-			if( t->union_no == static_cast<int32_t>(u))
-				print_tensor(t, dst);
-		}
+		for( auto t : union_members[u] )
+			print_tensor(t, dst);
 		dst << "};" <<std::endl;
 		dst << "static union tensor_union_" << u << " tu" << u << ";" << std::endl <<std::endl;
 	}
@@ -101,10 +169,22 @@ void Graph::print_global_tensors(std::ostream &dst)
 
 void Graph::print_functions(std::ostream &dst)
 {
+	// Printing the function parameters flips graph output tensors
+	// to non-const. Do that here, so the nodes can be printed in parallel.
 	for( auto n : nodes ) {
-		// handle meta-nodes separately
 		if( n->op_name == "graph_io" )
 			continue;
+		n->forEachOutput([](Tensor *t) {
+			if( t->is_used() && t->isIO )
+				t->isConst = false;
+		});
+	}
+
+	print_in_parallel(dst, nodes.size(), [this](unsigned i, std::ostream &dst) {
+		const Node *n = nodes[i];
+		// handle meta-nodes separately
+		if( n->op_name == "graph_io" )
+			return;
 		dst << "/*" << std::endl;
 		dst << " * Operand:           " << n->op_name << std::endl;
 		dst << " * Name in ONNX file: " << n->onnx_name << std::endl;
@@ -118,11 +198,62 @@ void Graph::print_functions(std::ostream &dst)
 		n->print(dst);
 
 		dst << "}" << std::endl << std::endl;
+	});
+}
+
+void Graph::print_in_parallel(std::ostream &dst, unsigned num_items, std::function<void(unsigned, std::ostream&)> print_item)
+{
+	unsigned num_threads = std::min(options.jobs, num_items);
+	if( num_threads <= 1 ) {
+		for( unsigned i=0; i<num_items; i++ )
+			print_item(i, dst);
+		return;
+	}
+
+	// Each item is printed into its own buffer, which are
+	// then written out in order. So the output is the same
+	// no matter which thread printed what.
+	std::vector<std::string> buffers(num_items);
+	std::vector<std::ios_base::fmtflags> end_flags(num_items);
+	std::atomic<unsigned> next_item(0);
+	auto worker = [&]() {
+		for( unsigned i = next_item++; i < num_items; i = next_item++ ) {
+			std::ostringstream buf;
+			buf.copyfmt(dst);
+			print_item(i, buf);
+			buffers[i] = buf.str();
+			end_flags[i] = buf.flags();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( unsigned t=0; t<num_threads; t++ )
+		threads.emplace_back(worker);
+	for( auto &t : threads )
+		t.join();
+
+	// Printing an item may change the stream's formatting (e.g. float
+	// initializers turn on std::showpoint). Printed serially, that carries
+	// over to whatever is printed next. Do the same here, so the rest of
+	// the output is not affected by this being run in parallel.
+	// NB: this assumes an item's output does not depend on the formatting
+	// left over from the previous items.
+	std::ios_base::fmtflags start_flags = dst.flags();
+	for( unsigned i=0; i<num_items; i++ ) {
+		dst << buffers[i];
+		if( end_flags[i] != start_flags )
+			dst.flags(end_flags[i]);
 	}
 }
 
 void Graph::print_includes(std::ostream &dst)
 {
+	if( options.node_hooks ) {
+		// For clock_gettime() in the default profiler
+		dst << "#if defined(ONNX2C_PROFILE) && !defined(_POSIX_C_SOURCE)" << std::endl;
+		dst << "#define _POSIX_C_SOURCE 199309L" << std::endl;
+		dst << "#endif" << std::endl;
+	}
 	dst << "#include <float.h>" << std::endl;
 	dst << "#include <math.h>" << std::endl;
 	dst << "#include <stdbool.h>" << std::endl;
@@ -139,6 +270,93 @@ void Graph::print_includes(std::ostream &dst)
 	}
 }
 
+/* 's' as a C string literal */
+static std::string c_string(const std::string &s)
+{
+	std::string rv = "\"";
+	for( char c : s ) {
+		if( c == '"' || c == '\\' )
+			rv += '\\';
+		if( (unsigned char)c < 0x20 )
+			continue;
+		rv += c;
+	}
+	return rv + "\"";
+}
+
+/* The tables of the nodes entry() calls, and the default
+ * implementation of the macros wrapped around the calls */
+void Graph::print_node_hooks(std::ostream &dst)
+{
+	std::vector<const Node*> calls;
+	for( auto n : nodes )
+		if( n->op_name != "graph_io" )
+			calls.push_back(n);
+
+	dst << "/* Each node call in entry() is wrapped in ONNX2C_NODE_BEGIN(id, name)" << std::endl;
+	dst << " * and ONNX2C_NODE_END(id). Define both before compiling, or define" << std::endl;
+	dst << " * ONNX2C_PROFILE to time the nodes with clock_gettime() and print" << std::endl;
+	dst << " * the times with onnx2c_print_profile(FILE*). The tables are static, so" << std::endl;
+	dst << " * the hooks must be defined in this file. To link several profiled" << std::endl;
+	dst << " * models, rename the function with -DONNX2C_PRINT_PROFILE=<name>. */" << std::endl;
+	dst << "#define ONNX2C_NUM_NODES " << calls.size() << std::endl;
+	dst << "#ifdef __GNUC__" << std::endl;
+	dst << "#define ONNX2C_MAYBE_UNUSED __attribute__((unused))" << std::endl;
+	dst << "#else" << std::endl;
+	dst << "#define ONNX2C_MAYBE_UNUSED" << std::endl;
+	dst << "#endif" << std::endl;
+	// NULL terminated, as C has no empty arrays
+	dst << "static const char *const onnx2c_node_names[ONNX2C_NUM_NODES+1] ONNX2C_MAYBE_UNUSED = {" << std::endl;
+	for( auto n : calls )
+		dst << "\t" << c_string(n->onnx_name) << "," << std::endl;
+	dst << "\tNULL" << std::endl << "};" << std::endl;
+	dst << "static const char *const onnx2c_node_ops[ONNX2C_NUM_NODES+1] ONNX2C_MAYBE_UNUSED = {" << std::endl;
+	for( auto n : calls )
+		dst << "\t" << c_string(n->op_name) << "," << std::endl;
+	dst << "\tNULL" << std::endl << "};" << std::endl;
+
+	dst << "#if defined(ONNX2C_PROFILE) && !defined(ONNX2C_NODE_BEGIN)" << std::endl;
+	dst << "#include <stdio.h>" << std::endl;
+	dst << "#include <time.h>" << std::endl;
+	dst << "static struct timespec onnx2c_node_start;" << std::endl;
+	dst << "static double onnx2c_node_seconds[ONNX2C_NUM_NODES+1];" << std::endl;
+	dst << "static unsigned long onnx2c_node_calls[ONNX2C_NUM_NODES+1];" << std::endl;
+	dst << "#define ONNX2C_NODE_BEGIN(id, name) clock_gettime(CLOCK_MONOTONIC, &onnx2c_node_start)" << std::endl;
+	dst << "#define ONNX2C_NODE_END(id) onnx2c_node_end(id)" << std::endl;
+	dst << "static void onnx2c_node_end(int id)" << std::endl;
+	dst << "{" << std::endl;
+	dst << "\tstruct timespec end;" << std::endl;
+	dst << "\tclock_gettime(CLOCK_MONOTONIC, &end);" << std::endl;
+	dst << "\tonnx2c_node_seconds[id] += (end.tv_sec - onnx2c_node_start.tv_sec)" << std::endl;
+	dst << "\t                          + (end.tv_nsec - onnx2c_node_start.tv_nsec) * 1e-9;" << std::endl;
+	dst << "\tonnx2c_node_calls[id]++;" << std::endl;
+	dst << "}" << std::endl;
+	dst << "#ifndef ONNX2C_PRINT_PROFILE" << std::endl;
+	dst << "#define ONNX2C_PRINT_PROFILE onnx2c_print_profile" << std::endl;
+	dst << "#endif" << std::endl;
+	dst << "void ONNX2C_PRINT_PROFILE(FILE *f)" << std::endl;
+	dst << "{" << std::endl;
+	dst << "\tdouble total = 0;" << std::endl;
+	dst << "\tfor( int i=0; i<ONNX2C_NUM_NODES; i++ )" << std::endl;
+	dst << "\t\ttotal += onnx2c_node_seconds[i];" << std::endl;
+	dst << "\tfprintf(f, \"%4s %-32s %-20s %8s %12s %12s %7s\\n\", \"id\", \"node\", \"op\", \"calls\", \"total ms\", \"avg us\", \"%\");" << std::endl;
+	dst << "\tfor( int i=0; i<ONNX2C_NUM_NODES; i++ ) {" << std::endl;
+	dst << "\t\tunsigned long calls = onnx2c_node_calls[i];" << std::endl;
+	dst << "\t\tdouble s = onnx2c_node_seconds[i];" << std::endl;
+	dst << "\t\tfprintf(f, \"%4d %-32s %-20s %8lu %12.3f %12.3f %7.2f\\n\", i, onnx2c_node_names[i], onnx2c_node_ops[i]," << std::endl;
+	dst << "\t\t        calls, s * 1e3, calls ? s * 1e6 / calls : 0.0, total > 0 ? 100 * s / total : 0.0);" << std::endl;
+	dst << "\t}" << std::endl;
+	dst << "\tfprintf(f, \"total %.3f ms\\n\", total * 1e3);" << std::endl;
+	dst << "}" << std::endl;
+	dst << "#endif" << std::endl;
+	dst << "#ifndef ONNX2C_NODE_BEGIN" << std::endl;
+	dst << "#define ONNX2C_NODE_BEGIN(id, name)" << std::endl;
+	dst << "#endif" << std::endl;
+	dst << "#ifndef ONNX2C_NODE_END" << std::endl;
+	dst << "#define ONNX2C_NODE_END(id)" << std::endl;
+	dst << "#endif" << std::endl;
+}
+
 void Graph::print_interface_function(std::ostream &dst, bool definition)
 {
 	bool isfirst = true;
@@ -195,15 +413,21 @@ void Graph::print_interface_function(std::ostream &dst, bool definition)
 	// since nodes were resolved from graph inputs in the order there were
 	// node inputs resolved, the nodes vector is now sorted in order so that
 	// we don't need to check dependancies :)
+	unsigned id = 0;
 	for( auto n : nodes )
 	{
 		// handle meta-nodes separately
 		if( n->op_name == "graph_io" )
 			continue;
 
+		if( options.node_hooks )
+			dst << "\tONNX2C_NODE_BEGIN(" << id << ", " << c_string(n->onnx_name) << ");" << std::endl;
 		dst << "\t" << n->c_name() << "( ";
 		n->print_function_parameters_callsite(dst);
 		dst << ");" << std::endl;
+		if( options.node_hooks )
+			dst << "\tONNX2C_NODE_END(" << id << ");" << std::endl;
+		id++;
 	}
 
 	dst << "}" << std::endl;
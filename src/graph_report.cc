@@ -0,0 +1,252 @@
+/* This file is part of onnx2c.
+ *
+ * Report of the memory the generated code needs, and the
+ * calculations it does, as JSON. Printed instead of the C source
+ * with the "--report json" option.
+ * The numbers are for the graph after the optimization passes.
+ */
+#include "graph.h"
+#include "options.h"
+
+#include <iostream>
+#include <unordered_set>
+
+#include "nodes/fused_elementwise.h"
+#include "nodes/gemm.h"
+#include "nodes/spatialfilter.h"
+
+using namespace toC;
+
+static std::string json_string(const std::string &s)
+{
+	std::string rv = "\"";
+	for( char c : s ) {
+		if( c == '"' || c == '\\' )
+			rv += '\\';
+		if( (unsigned char)c < 0x20 )
+			continue;
+		rv += c;
+	}
+	return rv + "\"";
+}
+
+static std::string json_shape(const Tensor *t)
+{
+	std::string rv = "[";
+	for( unsigned i=0; i<t->data_dim.size(); i++ ) {
+		if( i > 0 )
+			rv += ",";
+		rv += std::to_string(t->data_dim[i]);
+	}
+	return rv + "]";
+}
+
+static uint64_t num_bytes(const Tensor *t)
+{
+	return (uint64_t)t->data_num_elem() * t->data_elem_size();
+}
+
+/* Multiply-accumulates node 'n' calculates. Only the nodes doing
+ * matrix multiplications or convolutions have them. */
+static uint64_t num_macs(const Node *n)
+{
+	const std::string &op = n->op_name;
+	if( op == "Conv" || op == "ConvInteger" ) {
+		// Each output element takes a filter of C/group channels.
+		// Not from the shape of W, as the im2col pass repacks it.
+		const SpatialFilter *f = static_cast<const SpatialFilter*>(n);
+		uint64_t filter = n->get_input_tensor(0)->data_dim[1] / f->group;
+		for( auto k : f->kernel_shape )
+			filter *= k;
+		return (uint64_t)n->get_output_tensor(0)->data_num_elem() * filter;
+	}
+	if( op == "ConvTranspose" ) {
+		// W is [C][M/group][kernel...], and each input element takes one filter
+		const Tensor *W = n->get_input_tensor(1);
+		return (uint64_t)n->get_input_tensor(0)->data_num_elem() * (W->data_num_elem() / W->data_dim[0]);
+	}
+	if( op == "Gemm" ) {
+		const Tensor *A = n->get_input_tensor(0);
+		int K = static_cast<const Gemm*>(n)->transA ? A->data_dim[0] : A->data_dim[1];
+		return (uint64_t)n->get_output_tensor(0)->data_num_elem() * K;
+	}
+	if( op == "MatMul" || op == "MatMulInteger" ) {
+		const Tensor *A = n->get_input_tensor(0);
+		return (uint64_t)n->get_output_tensor(0)->data_num_elem() * A->data_dim.back();
+	}
+	return 0;
+}
+
+/* An estimate of the arithmetic operations node 'n' does: two for each
+ * multiply-accumulate, the kernel size for each pooling output, and
+ * otherwise one for each output element (for each fused step). */
+static uint64_t num_flops(const Node *n)
+{
+	uint64_t macs = num_macs(n);
+	if( macs > 0 )
+		return 2 * macs;
+
+	uint64_t out_elems = 0;
+	for( unsigned i=0; i<n->get_number_of_outputs(); i++ )
+		out_elems += n->get_output_tensor(i)->data_num_elem();
+	if( n->op_name == "AveragePool" || n->op_name == "MaxPool" ) {
+		uint64_t kernel = 1;
+		for( auto k : static_cast<const SpatialFilter*>(n)->kernel_shape )
+			kernel *= k;
+		return out_elems * kernel;
+	}
+	if( n->op_name == "FusedElementwise" )
+		return out_elems * static_cast<const FusedElementwise*>(n)->get_number_of_steps();
+	return out_elems;
+}
+
+void Graph::print_report_json(std::ostream &dst)
+{
+	// The nodes in the order entry() calls them
+	// and the first call calculating, and the last using each tensor.
+	// As in intermediate_lifetimes(), an alias is a part of the
+	// tensor it is a view into, and has the lifetime of that.
+	std::vector<const Node*> calls;
+	std::unordered_map<const Tensor*, unsigned> first_use, last_use;
+	for( auto n : nodes ) {
+		if( n->op_name == "graph_io" )
+			continue;
+		unsigned i = calls.size();
+		calls.push_back(n);
+		for( unsigned j=0; j<n->get_number_of_outputs(); j++ )
+			first_use.emplace(alias_root(n->get_output_tensor(j)), i);
+		for( unsigned j=0; j<n->get_number_of_inputs(); j++ )
+			last_use[alias_root(n->get_input_tensor(j))] = i;
+	}
+	auto use = [](const std::unordered_map<const Tensor*, unsigned> &uses, Tensor *t) {
+		auto u = uses.find(alias_root(t));
+		return u == uses.end() ? std::string("null") : std::to_string(u->second);
+	};
+
+	dst << "{" << std::endl;
+	dst << "\"model\": " << json_string(options.input_file) << "," << std::endl;
+
+	// The tensors that are in the generated code
+	uint64_t flash = 0, ram = 0, io = 0;
+	std::unordered_set<const Tensor*> static_ram;
+	std::vector<uint64_t> union_sizes(tensor_unions.size(), 0);
+	dst << "\"tensors\": [" << std::endl;
+	bool first = true;
+	for( auto t : tensors ) {
+		if( (t->generate == false && t->isIO == false) || t->name == "" || t->data_num_elem() == 0 )
+			continue;
+		uint64_t bytes = num_bytes(t);
+		std::string memory, placement;
+		if( t->isIO ) {
+			memory = "io";
+			placement = "\"parameter\"";
+			io += bytes;
+		}
+		else if( t->isAliasOf ) {
+			memory = "alias";
+			const Tensor *root = t;
+			uint64_t offset = 0;
+			for( ; root->isAliasOf; root = root->isAliasOf )
+				offset += root->alias_offset * root->isAliasOf->data_elem_size();
+			placement = "{\"alias_of\": " + json_string(root->name) + ", \"offset\": " + std::to_string(offset) + "}";
+		}
+		else if( t->isConst && t->initialize ) {
+			memory = "flash";
+			placement = "\"static\"";
+			flash += bytes;
+		}
+		else {
+			memory = "ram";
+			auto a = arena_offsets.find(t);
+			if( t->union_no >= 0 ) {
+				placement = "{\"union\": " + std::to_string(t->union_no) + "}";
+				union_sizes[t->union_no] = std::max(union_sizes[t->union_no], bytes);
+			}
+			else if( a != arena_offsets.end() )
+				placement = "{\"arena\": " + std::to_string(a->second) + "}";
+			else {
+				placement = "\"static\"";
+				static_ram.insert(t);
+				ram += bytes;
+			}
+		}
+
+		if( !first )
+			dst << "," << std::endl;
+		first = false;
+		dst << "  {\"name\": " << json_string(t->name);
+		dst << ", \"type\": " << json_string(t->data_type_str());
+		dst << ", \"shape\": " << json_shape(t);
+		dst << ", \"bytes\": " << bytes;
+		dst << ", \"memory\": \"" << memory << "\"";
+		dst << ", \"placement\": " << placement;
+		dst << ", \"first_use\": " << use(first_use, t);
+		dst << ", \"last_use\": " << use(last_use, t);
+		dst << "}";
+	}
+	dst << std::endl << "]," << std::endl;
+
+	// The nodes
+	uint64_t total_macs = 0, total_flops = 0;
+	dst << "\"nodes\": [" << std::endl;
+	for( unsigned i=0; i<calls.size(); i++ ) {
+		const Node *n = calls[i];
+		uint64_t bytes_read = 0, bytes_written = 0;
+		uint64_t macs = num_macs(n), flops = num_flops(n);
+		total_macs += macs;
+		total_flops += flops;
+
+		dst << "  {\"index\": " << i;
+		dst << ", \"name\": " << json_string(n->onnx_name);
+		dst << ", \"op\": " << json_string(n->op_name);
+		dst << ", \"inputs\": [";
+		bool first_input = true;
+		for( unsigned j=0; j<n->get_number_of_inputs(); j++ ) {
+			const Tensor *t = n->get_input_tensor(j);
+			if( t->is_used() == false )
+				continue;
+			bytes_read += num_bytes(t);
+			dst << (first_input ? "" : ", ") << "{\"tensor\": " << json_string(t->name) << ", \"shape\": " << json_shape(t) << "}";
+			first_input = false;
+		}
+		dst << "], \"outputs\": [";
+		bool first_output = true;
+		for( unsigned j=0; j<n->get_number_of_outputs(); j++ ) {
+			const Tensor *t = n->get_output_tensor(j);
+			bytes_written += num_bytes(t);
+			dst << (first_output ? "" : ", ") << "{\"tensor\": " << json_string(t->name) << ", \"shape\": " << json_shape(t) << "}";
+			first_output = false;
+		}
+		dst << "]";
+		dst << ", \"macs\": " << macs;
+		dst << ", \"flops\": " << flops;
+		dst << ", \"bytes_read\": " << bytes_read;
+		dst << ", \"bytes_written\": " << bytes_written;
+		dst << "}" << (i+1 < calls.size() ? "," : "") << std::endl;
+	}
+	dst << "]," << std::endl;
+
+	// RAM: the unions, the arena, and the other non-constant tensors.
+	// The peak is the most bytes the intermediate tensors need at the
+	// same time, on top of the tensors that are always in RAM.
+	uint64_t planned_ram = arena_size;
+	for( auto s : union_sizes )
+		planned_ram += s;
+	std::vector<TensorLifetime> lifetimes = intermediate_lifetimes();
+	uint64_t always_in_ram = ram;
+	for( auto &l : lifetimes )
+		if( static_ram.count(l.t) )
+			always_in_ram -= num_bytes(l.t);
+	uint64_t peak_ram = always_in_ram + peak_bytes(lifetimes);
+
+	dst << "\"totals\": {";
+	dst << "\"flash\": " << flash;
+	dst << ", \"ram\": " << ram + planned_ram;
+	dst << ", \"peak_ram\": " << peak_ram;
+	dst << ", \"io\": " << io;
+	dst << ", \"macs\": " << total_macs;
+	dst << ", \"flops\": " << total_flops;
+	dst << ", \"flash_deduped\": " << deduped_bytes;
+	dst << "}" << std::endl;
+	dst << "}" << std::endl;
+}
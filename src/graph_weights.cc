@@ -0,0 +1,181 @@
+/* This file is part of onnx2c
+ *
+ * Writing the constant tensors out of the generated C source,
+ * into a binary file. The file is either compiled into the binary
+ * (.incbin), or loaded at run time (entry_init()).
+ */
+
+#include "error.h"
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace toC;
+
+/* Alignment of each tensor in the weights blob. A cache line,
+ * which is also enough for any SIMD load the C compiler might use. */
+#define WEIGHTS_BLOB_ALIGN 64
+
+/* Header of the run time loaded weights file. All in the byte order
+ * of the machine onnx2c ran on, which must match the target.
+ *   0: magic "ONNX2CW\0"
+ *   8: uint32_t file format version
+ *  12: uint32_t byte order mark, 0x01020304
+ *  16: uint64_t size of the data following the header
+ *  24: uint64_t hash of the tensor layout (names, types, shapes and offsets)
+ *  32: zero padding
+ */
+#define WEIGHTS_FILE_MAGIC "ONNX2CW"
+#define WEIGHTS_FILE_VERSION 1
+#define WEIGHTS_FILE_HEADER_SIZE WEIGHTS_BLOB_ALIGN
+
+bool Graph::goes_to_weights_blob(const Tensor *t) const
+{
+	// Graph inputs and outputs are function parameters, and
+	// non-constants get written to. Leave those as they are.
+	return t->generate
+	    && t->initialize
+	    && t->isConst
+	    && t->isIO == false
+	    && t->union_no < 0
+	    && t->isAliasOf == nullptr
+	    && t->name != ""
+	    && t->data_buffer != nullptr
+	    && t->data_num_elem() > 0;
+}
+
+// FNV-1a, so the hash is the same on every host
+static void hash_bytes(uint64_t &hash, const void *data, size_t len)
+{
+	const uint8_t *d = static_cast<const uint8_t*>(data);
+	for( size_t i=0; i<len; i++ ) {
+		hash ^= d[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+void Graph::write_weights_blob(const std::string &filename, bool runtime_loaded)
+{
+	PassTimer timer("write weights");
+	// Lay out the tensors first. The runtime loaded file's
+	// header needs the total size and a hash of the layout.
+	std::vector<Tensor*> blob_tensors;
+	uint64_t offset = 0;
+	uint64_t layout_hash = 0xcbf29ce484222325ULL;
+	for( auto t : tensors ) {
+		if( goes_to_weights_blob(t) == false )
+			continue;
+
+		offset += (WEIGHTS_BLOB_ALIGN - offset % WEIGHTS_BLOB_ALIGN) % WEIGHTS_BLOB_ALIGN;
+		weights_blob_offsets[t] = offset;
+		blob_tensors.push_back(t);
+		LOG(TRACE) << "  " << t->cname() << " at offset " << offset << std::endl;
+
+		std::string layout = t->print_tensor("", false, true) + "@" + std::to_string(offset) + ";";
+		hash_bytes(layout_hash, layout.data(), layout.size());
+		offset += (uint64_t)t->data_num_elem() * t->data_elem_size();
+	}
+	weights_blob_size = offset;
+	weights_layout_hash = layout_hash;
+
+	std::ofstream blob(filename, std::ios::binary);
+	if( !blob.good() )
+		ERROR("Could not open weights blob file " << filename << " for writing");
+	LOG(DEBUG) << "Writing constant tensors to " << filename << std::endl;
+
+	if( runtime_loaded ) {
+		char header[WEIGHTS_FILE_HEADER_SIZE] = {0};
+		uint32_t version = WEIGHTS_FILE_VERSION;
+		uint32_t byte_order = 0x01020304;
+		memcpy(header, WEIGHTS_FILE_MAGIC, sizeof(WEIGHTS_FILE_MAGIC));
+		memcpy(header+8, &version, 4);
+		memcpy(header+12, &byte_order, 4);
+		memcpy(header+16, &weights_blob_size, 8);
+		memcpy(header+24, &weights_layout_hash, 8);
+		blob.write(header, sizeof(header));
+	}
+
+	static const char padding[WEIGHTS_BLOB_ALIGN] = {0};
+	uint64_t written = 0;
+	for( auto t : blob_tensors ) {
+		blob.write(padding, weights_blob_offsets[t] - written);
+		uint64_t size = (uint64_t)t->data_num_elem() * t->data_elem_size();
+		blob.write(static_cast<const char*>(t->data_buffer), size);
+		written = weights_blob_offsets[t] + size;
+	}
+
+	if( !blob.good() )
+		ERROR("Error writing weights blob file " << filename);
+	LOG(INFO) << "Wrote " << blob_tensors.size() << " constant tensors, "
+	          << weights_blob_size << " bytes, to " << filename << std::endl;
+	weights_blob_file = filename;
+	weights_blob_runtime = runtime_loaded;
+	timer.set_items(blob_tensors.size());
+}
+
+void Graph::print_weights_blob(std::ostream &dst)
+{
+	if( weights_blob_runtime ) {
+		print_weights_init_function(dst);
+		return;
+	}
+
+	// The file name goes into an assembler string inside a C string
+	std::string escaped;
+	for( char c : weights_blob_file ) {
+		if( c == '\\' || c == '"' )
+			escaped += "\\\\\\";
+		escaped += c;
+	}
+
+	dst << "/* The constant tensors are in a binary file, assembled into the" << std::endl;
+	dst << " * read-only data as-is. Each tensor is " << WEIGHTS_BLOB_ALIGN << "-byte aligned. */" << std::endl;
+	dst << "__asm__(" << std::endl;
+	dst << "\t\".section .rodata\\n\"" << std::endl;
+	dst << "\t\".balign " << WEIGHTS_BLOB_ALIGN << "\\n\"" << std::endl;
+	dst << "\t\"onnx2c_weights:\\n\"" << std::endl;
+	dst << "\t\".incbin \\\"" << escaped << "\\\"\\n\"" << std::endl;
+	dst << "\t\".previous\\n\"" << std::endl;
+	dst << ");" << std::endl;
+	dst << "extern const uint8_t onnx2c_weights[];" << std::endl;
+	dst << std::endl;
+}
+
+void Graph::print_weights_init_function(std::ostream &dst)
+{
+	dst << "/* The constant tensors are loaded at run time from a weights file" << std::endl;
+	dst << " * written by onnx2c. Call entry_init() with the file's contents" << std::endl;
+	dst << " * (e.g. mmap()ed) before calling entry(). The memory must stay valid" << std::endl;
+	dst << " * while entry() is used, and be at least 8-byte aligned." << std::endl;
+	dst << " * entry_init() can be called again to switch to new weights, if the" << std::endl;
+	dst << " * network was exported with the same structure." << std::endl;
+	dst << " * Returns 0 on success, non-zero if the weights don't fit this network. */" << std::endl;
+	dst << "static const uint8_t *onnx2c_weights;" << std::endl;
+	dst << "int entry_init(const void *weights, size_t len)" << std::endl;
+	dst << "{" << std::endl;
+	dst << "\tconst uint8_t *w = (const uint8_t*)weights;" << std::endl;
+	dst << "\tuint32_t version, byte_order;" << std::endl;
+	dst << "\tuint64_t size, layout_hash;" << std::endl;
+	dst << "\tif( w == NULL || len < " << WEIGHTS_FILE_HEADER_SIZE << " || ((uintptr_t)w % 8) != 0 )" << std::endl;
+	dst << "\t\treturn 1;" << std::endl;
+	dst << "\tif( memcmp(w, \"" << WEIGHTS_FILE_MAGIC << "\", " << sizeof(WEIGHTS_FILE_MAGIC) << ") != 0 )" << std::endl;
+	dst << "\t\treturn 1;" << std::endl;
+	dst << "\tmemcpy(&version, w+8, 4);" << std::endl;
+	dst << "\tmemcpy(&byte_order, w+12, 4);" << std::endl;
+	dst << "\tmemcpy(&size, w+16, 8);" << std::endl;
+	dst << "\tmemcpy(&layout_hash, w+24, 8);" << std::endl;
+	dst << "\tif( version != " << WEIGHTS_FILE_VERSION << " || byte_order != 0x01020304 )" << std::endl;
+	dst << "\t\treturn 1;" << std::endl;
+	dst << "\tif( size != " << weights_blob_size << "ULL || layout_hash != 0x" << std::hex << weights_layout_hash << std::dec << "ULL )" << std::endl;
+	dst << "\t\treturn 1;" << std::endl;
+	dst << "\tif( len - " << WEIGHTS_FILE_HEADER_SIZE << " < size )" << std::endl;
+	dst << "\t\treturn 1;" << std::endl;
+	dst << "\tonnx2c_weights = w + " << WEIGHTS_FILE_HEADER_SIZE << ";" << std::endl;
+	dst << "\treturn 0;" << std::endl;
+	dst << "}" << std::endl;
+	dst << std::endl;
+}
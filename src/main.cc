@@ -1,12 +1,13 @@
 /* This file is part of onnx2c.
  */
 #include <iostream>
-#include <fstream>
 
 #include "onnx.pb.h"
 
 #include "graph.h"
+#include "model_loader.h"
 #include "options.h"
+#include "pass_timer.h"
 #include "tensor.h"
 
 int main(int argc, const char *argv[])
@@ -15,17 +16,36 @@ int main(int argc, const char *argv[])
 
 	parse_cmdline_options(argc, argv);
 
-	std::ifstream input(options.input_file);
-	if (!input.good()) {
-		std::cerr << "Error opening input file: \"" << options.input_file << "\""  << std::endl;
-		exit(1); //TODO: check out error numbers for a more accurate one
+	// Timed until the graph is destroyed, before the times are printed
+	{
+		toC::PassTimer total_timer("onnx2c");
+		{
+			toC::PassTimer timer("load model");
+			if( toC::load_onnx_model(options.input_file, onnx_model) == false ) {
+				std::cerr << "Error reading input file: \"" << options.input_file << "\""  << std::endl;
+				exit(1); //TODO: check out error numbers for a more accurate one
+			}
+			timer.set_items(onnx_model.graph().node_size());
+		}
+
+		std::cout.precision(20);
+		toC::Graph toCgraph(onnx_model);
+		toCgraph.optimize();
+		if( options.report == "json" ) {
+			toCgraph.print_report_json(std::cout);
+		}
+		else {
+			if( options.weights_blob != "" )
+				toCgraph.write_weights_blob(options.weights_blob);
+			if( options.weights_file != "" )
+				toCgraph.write_weights_blob(options.weights_file, true);
+			toCgraph.print_source(std::cout);
+		}
 	}
-	onnx_model.ParseFromIstream(&input);
 
-	std::cout.precision(20);
-	toC::Graph toCgraph(onnx_model);
-	if( options.opt_unionize )
-		toCgraph.unionize_tensors();
-	toCgraph.print_source(std::cout);
+	if( options.time_passes )
+		toC::print_pass_times(std::cerr);
+	if( options.trace_file != "" )
+		toC::write_pass_trace(options.trace_file);
 }
 
@@ -0,0 +1,136 @@
+/* This file is part of onnx2c.
+ *
+ * Reading the .onnx file from disk.
+ * For big models, protobuf's ParseFromIstream() copies the file
+ * through a small stream buffer. Map the file instead, and let protobuf
+ * parse straight from the page cache.
+ */
+#include <climits>
+#include <fstream>
+#include <map>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include "error.h"
+#include "model_loader.h"
+
+using namespace toC;
+
+// Directory of the loaded .onnx file, with the trailing '/'.
+// External tensor data files are relative to this.
+static std::string model_directory;
+// Mapped external data files, by their path. Kept until exit
+// since the tensors' data_buffers point into these.
+static std::map<std::string, std::unique_ptr<MappedFile>> external_files;
+
+MappedFile::MappedFile(const std::string &filename, bool copy_on_write)
+	: addr(nullptr), length(0)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if( fd < 0 )
+		return;
+
+	struct stat sb;
+	if( fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 ) {
+		int prot = copy_on_write ? PROT_READ|PROT_WRITE : PROT_READ;
+		void *p = mmap(nullptr, sb.st_size, prot, MAP_PRIVATE, fd, 0);
+		if( p != MAP_FAILED ) {
+			addr = p;
+			length = sb.st_size;
+			// Both the protobuf parser and printing out the weights
+			// read the file more or less front to back, once.
+			madvise(addr, length, MADV_SEQUENTIAL);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if( addr )
+		munmap(addr, length);
+}
+
+bool toC::load_onnx_model(const std::string &filename, onnx::ModelProto &model)
+{
+	size_t last_slash = filename.find_last_of('/');
+	if( last_slash == std::string::npos )
+		model_directory = "";
+	else
+		model_directory = filename.substr(0, last_slash+1);
+
+	MappedFile file(filename);
+
+	if( file.good() == false ) {
+		LOG(DEBUG) << "Could not mmap '" << filename << "', reading it as a stream" << std::endl;
+		std::ifstream input(filename);
+		if( !input.good() )
+			return false;
+		return model.ParseFromIstream(&input);
+	}
+
+	// Protobuf messages are limited to 2GB. Larger models must
+	// be saved with their tensors as external data.
+	if( file.size() > INT_MAX ) {
+		LOG(ERROR) << "'" << filename << "' is larger than 2GB, which protobuf can not parse" << std::endl;
+		return false;
+	}
+
+	LOG(DEBUG) << "Parsing " << file.size() << " bytes of mmap()ed '" << filename << "'" << std::endl;
+	::google::protobuf::io::ArrayInputStream input_stream(file.data(), file.size());
+	::google::protobuf::io::CodedInputStream coded_stream(&input_stream);
+	coded_stream.SetTotalBytesLimit(INT_MAX);
+	return model.ParseFromCodedStream(&coded_stream)
+	    && coded_stream.ConsumedEntireMessage();
+}
+
+void* toC::get_external_tensor_data(const onnx::TensorProto &tensor, size_t &length)
+{
+	std::string location;
+	uint64_t offset = 0;
+	bool has_length = false;
+	for( const auto &e : tensor.external_data() ) {
+		if( e.key() == "location" )
+			location = e.value();
+		else if( e.key() == "offset" )
+			offset = std::stoull(e.value());
+		else if( e.key() == "length" ) {
+			length = std::stoull(e.value());
+			has_length = true;
+		}
+		// "checksum" and other keys are ignored
+	}
+
+	if( location == "" )
+		ERROR("External data of tensor " << tensor.name() << " has no location");
+	if( location[0] == '/' )
+		ERROR("External data location of tensor " << tensor.name() << " must be relative to the model file");
+
+	std::string path = model_directory + location;
+	std::unique_ptr<MappedFile> &file = external_files[path];
+	if( file == nullptr ) {
+		LOG(DEBUG) << "Mapping external data file '" << path << "'" << std::endl;
+		// Nodes may modify their constant inputs' data_buffer in place.
+		// Copy-on-write keeps that from touching the weights file.
+		file.reset(new MappedFile(path, true));
+	}
+	if( file->good() == false )
+		ERROR("Could not map external data file '" << path << "' of tensor " << tensor.name());
+
+	if( offset > file->size() )
+		ERROR("External data offset of tensor " << tensor.name() << " is past the end of '" << path << "'");
+	if( has_length == false )
+		length = file->size() - offset;
+	else if( length > file->size() - offset )
+		ERROR("External data of tensor " << tensor.name() << " runs past the end of '" << path << "'");
+
+	return (void*)(file->data() + offset);
+}
@@ -0,0 +1,56 @@
+/* This file is part of onnx2c.
+ *
+ * Reading the .onnx file from disk.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "onnx.pb.h"
+
+namespace toC {
+
+/* A memory mapping of a whole file.
+ * The mapping is released when this object is destroyed.
+ * If mapping fails (e.g. the file does not exist, or is a pipe)
+ * data() returns nullptr.
+ * The mapping is read-only, unless 'copy_on_write' is given. Then
+ * the mapped pages may be written to. The writes
+ * are private to onnx2c and never end up in the file.
+ */
+class MappedFile {
+public:
+	MappedFile(const std::string &filename, bool copy_on_write=false);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data(void) const { return (const uint8_t*)addr; }
+	size_t size(void) const { return length; }
+	bool good(void) const { return addr != nullptr; }
+
+private:
+	void *addr;
+	size_t length;
+};
+
+/* Parse the ONNX model in 'filename' into 'model'.
+ * The file is mmap()ed and protobuf parses directly from
+ * the mapping, without any intermediate stream buffering.
+ * Falls back to reading via an std::ifstream if the file
+ * can't be mapped (e.g. it is a pipe).
+ * Returns false if the file can't be read or parsed.
+ */
+bool load_onnx_model(const std::string &filename, onnx::ModelProto &model);
+
+/* Get the data of a tensor stored outside the .onnx file
+ * (i.e. with data_location EXTERNAL).
+ * The file in the tensor's "location" entry is looked up relative to the
+ * directory of the model loaded with load_onnx_model(). Each such file is
+ * mapped once, and the returned pointer into it stays valid until onnx2c exits.
+ * 'length' is set to the number of bytes of data.
+ */
+void* get_external_tensor_data(const onnx::TensorProto &tensor, size_t &length);
+
+}
@@ -136,7 +136,7 @@ void Node::print_parameters(std::ostream &dst, bool not_callsite ) const
 		// corner case with Shape node: in case the shape output is graph output
 		// it is marked const (since other nodes have already used the compile-time generated output
 		// of the shape node).
-		if( t->isIO )
+		if( t->isIO && t->isConst )
 			t->isConst = false;
 
 		if( not_callsite )
@@ -181,6 +181,10 @@ void Node::register_output(unsigned output_no, std::string name)
 {
 	std::get<1>(output_params[output_no]) = name;
 }
+void Node::replace_output(unsigned output_no, Tensor *t)
+{
+	std::get<0>(output_params[output_no]) = t;
+}
 Tensor* Node::get_output_tensor(unsigned N) const
 {
 	if( output_params.size() < N )
@@ -89,7 +89,7 @@ public:
 	bool is_output_N_used(unsigned N) const;
 
 	/* Not all node types have attributes. Override where needed */
-	virtual void parseAttributes( onnx::NodeProto &node )
+	virtual void parseAttributes( const onnx::NodeProto &node )
 	{
 		ERROR("Attribute parsing not implemented for node operation type " << op_name);
 	}
@@ -131,6 +131,9 @@ public:  // TODO: split up into more protected functions
 	void register_output(Tensor *, std::string name);
 	void name_input(unsigned input_no, std::string name);
 	void register_output(unsigned output_no, std::string name);
+	/* Make the node write its Nth output into another tensor.
+	 * For optimization passes that remove the node after this one. */
+	void replace_output(unsigned output_no, Tensor *t);
 
 };
 }
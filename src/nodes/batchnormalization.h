@@ -47,7 +47,7 @@ class BatchNormalization : public Node {
 		momentum = a.f();
 	}
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "epsilon" )
@@ -6,7 +6,7 @@
 
 namespace toC {
 
-void Cast::parseAttributes( onnx::NodeProto &node )
+void Cast::parseAttributes( const onnx::NodeProto &node )
 {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
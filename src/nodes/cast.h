@@ -16,7 +16,7 @@ class Cast : public Node {
 
 	std::string output_type;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 	virtual void resolve(void) override;
 	virtual void print(std::ostream &dst) const override;
 };
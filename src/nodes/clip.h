@@ -19,7 +19,7 @@ class Clip : public Node {
 	float min_attr, max_attr;
 
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "min" )
@@ -16,7 +16,12 @@ namespace toC {
 		// attribute
 		int axis;
 
-		void parseAttributes(onnx::NodeProto &node) override {
+		// Inputs that are aliases of their part of the output,
+		// so their producers already wrote them in place.
+		// Set by the inplace_concat optimization pass.
+		std::vector<bool> inputs_in_place;
+
+		void parseAttributes( const onnx::NodeProto &node ) override {
 			for (const auto &a : node.attribute()) {
 				if (a.name() == "axis") {
 					if (a.type() != onnx::AttributeProto_AttributeType_INT)
@@ -31,14 +36,17 @@ namespace toC {
 
 			dst << "\t/* Concat */" << std::endl;
 			const Tensor *concat_result = get_output_tensor(0);
+			std::string type = concat_result->data_type_str();
 
 			// the axisPitch is the number of elements to add to move to the next split axis in the concat_result
 			int64_t axisPitch = 1;
 			for (int i = concat_result->data_dim.size() - 1; i >= axis; i--) {
 				axisPitch *= concat_result->data_dim[i];
 			}
-
-			dst << "\tint64_t outputOffset;" << std::endl;
+			if (axisPitch == 0)
+				return;
+			// the number of contiguous runs each input is copied as
+			int64_t runs = concat_result->data_num_elem() / axisPitch;
 
 			int64_t outputBase = 0;
 			int64_t input_count = get_number_of_inputs();
@@ -54,28 +62,30 @@ namespace toC {
 					inputAxisPitch *= get_input_tensor(inputIndex)->data_dim[i];
 				}
 
-				int64_t inputSize = get_input_tensor(inputIndex)->data_num_elem();
-
-				// copy the data across: for every 'inputAxisPitch' values copied, we move over by the 'axisPitch'
-				dst << "\toutputOffset = " << outputBase << ";" << std::endl;
-				dst << "\tfor (int64_t i = 0, j = 0; i < " << inputSize << "; i++) {" << std::endl;
-
-				dst << "\t\t*((" << concat_result ->data_type_str() << "*)output";
-				dst << " + (outputOffset + i)) = *((" << concat_result ->data_type_str() << "*)";
-				dst << input_name << " + i);" << std::endl;
-
-				dst << "\t\tif (++j == " << inputAxisPitch << ") {" << std::endl;
-				dst << "\t\t\toutputOffset += (" << axisPitch - inputAxisPitch << ");" << std::endl;
-				dst << "\t\t\tj = 0;" << std::endl;
-				dst << "\t\t}" << std::endl;
-
-				dst << "\t}" << std::endl;
+				if (is_input_in_place(inputIndex)) {
+					dst << "\t/* " << input_name << " is already in place */" << std::endl;
+				}
+				else if (runs == 1) {
+					dst << "\tmemcpy((" << type << "*)output + " << outputBase << ", ";
+					dst << input_name << ", " << inputAxisPitch << " * sizeof(" << type << "));" << std::endl;
+				}
+				else {
+					// copy the data across: each run of 'inputAxisPitch' values goes 'axisPitch' apart in the output
+					dst << "\tfor (int64_t r = 0; r < " << runs << "; r++)" << std::endl;
+					dst << "\t\tmemcpy((" << type << "*)output + r*" << axisPitch << " + " << outputBase << ", ";
+					dst << "(const " << type << "*)" << input_name << " + r*" << inputAxisPitch << ", ";
+					dst << inputAxisPitch << " * sizeof(" << type << "));" << std::endl;
+				}
 
 				outputBase += inputAxisPitch;
 			}
 
 		}
 
+		bool is_input_in_place(unsigned input_no) const {
+			return input_no < inputs_in_place.size() && inputs_in_place[input_no];
+		}
+
 		void resolve(void) override {
 			if (get_number_of_inputs() == 1 ) {
 				LOG(WARNING) << "Concat node " << onnx_name << " has only one input." << std::endl;
@@ -14,7 +14,7 @@ class Constant : public Node {
 
 	Tensor *value_tensor = nullptr;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "value" ) {
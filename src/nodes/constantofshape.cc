@@ -5,7 +5,7 @@
 #include "constantofshape.h"
 using namespace toC;
 
-void ConstantOfShape::parseAttributes( onnx::NodeProto &node )
+void ConstantOfShape::parseAttributes( const onnx::NodeProto &node )
 {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
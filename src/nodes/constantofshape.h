@@ -29,7 +29,7 @@ class ConstantOfShape : public Node {
 	const Tensor *value;
 
 	// Mandatory "API" functions towards the rest of onnx2c
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 	virtual void resolve(void) override;
 	virtual void print(std::ostream &dst) const override;
 };
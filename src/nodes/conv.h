@@ -5,6 +5,7 @@
  */
 
 #include "spatialfilter.h"
+#include "winograd.h"
 namespace toC {
 
 class Conv : public SpatialFilter {
@@ -13,6 +14,31 @@ class Conv : public SpatialFilter {
 		op_name = "Conv";
 	}
 
+	// The im2col + GEMM calculation (see im2col_convolutions.cpp)
+	// is done in blocks of this many output channels and outputs
+	static constexpr unsigned IM2COL_MR = 4;
+	static constexpr unsigned IM2COL_NR = 16;
+	// Outputs per tile of the im2col calculation. 0 for the direct loops.
+	unsigned im2col_tile = 0;
+	// Are the weights packed into [M/IM2COL_MR][K][IM2COL_MR] for it
+	bool im2col_packed_w = false;
+	// Output tile size of the Winograd calculation (see
+	// winograd_convolutions.cpp), 0 if not used, and the number
+	// of tiles calculated at a time
+	unsigned winograd_m = 0;
+	unsigned winograd_tiles = 0;
+	// Are the weights transformed at compile time. If not,
+	// they get transformed into output 'u' in each call.
+	bool winograd_const_w = false;
+
+	// Depthwise kernels larger than this are not unrolled,
+	// but calculated with the generic loops
+	static constexpr unsigned DEPTHWISE_MAX_KERNEL = 49;
+	// Pointwise convolutions are calculated in blocks of this
+	// many output channels and outputs, kept in registers
+	static constexpr unsigned POINTWISE_MR = 4;
+	static constexpr unsigned POINTWISE_NR = 16;
+
 	virtual void print_output_cell_init(std::ostream &dst, const std::string &y_idx) const override
 	{
 		std::string outidx="";
@@ -46,13 +72,432 @@ class Conv : public SpatialFilter {
 	}
 	virtual void print_output_cell_finalize(std::ostream &dst, const std::string &y_idx) const override
 	{
+		activation.print_in_place(dst, "\t\t\t", "y" + y_idx);
 	}
 	virtual void print(std::ostream &dst) const override
 	{
 		print_header_info_comment(dst);
-		print_loop_with_padding_checks(dst);
+		if( winograd_m > 0 )
+			print_winograd(dst);
+		else if( im2col_tile > 0 )
+			print_im2col(dst);
+		else if( is_depthwise() )
+			print_depthwise(dst);
+		else if( is_pointwise() )
+			print_pointwise(dst);
+		else
+			print_loop_with_padding_checks(dst);
+	}
+
+	/* Copy the input patches of a tile of outputs into the columns of
+	 * 'col', then multiply the weights with 'col', IM2COL_MR output
+	 * channels and IM2COL_NR outputs at a time. Constant weights are
+	 * packed into blocks of IM2COL_MR output channels by the
+	 * optimization pass, others are read from their rows. */
+	void print_im2col(std::ostream &dst) const
+	{
+		const unsigned MR = IM2COL_MR, NR = IM2COL_NR;
+		unsigned batch_size = get_X()->data_dim[0];
+		unsigned channels = get_X()->data_dim[1];
+		unsigned in_h = get_X()->data_dim[2];
+		unsigned in_w = get_X()->data_dim[3];
+		unsigned maps = get_Y()->data_dim[1];
+		unsigned out_w = get_Y()->data_dim[3];
+		unsigned outputs = get_Y()->data_dim[2] * out_w;
+		unsigned K = channels * kernel_shape[0] * kernel_shape[1];
+		unsigned blocks = (maps + MR - 1) / MR;
+
+		INDT_1 << "for( uint32_t b=0; b<" << batch_size << "; b++ ) {" << std::endl;
+		INDT_1 << "for( uint32_t p0=0; p0<" << outputs << "; p0+=" << im2col_tile << " ) {" << std::endl;
+		INDT_2 << "uint32_t np = " << outputs << "-p0 < " << im2col_tile << " ? " << outputs << "-p0 : " << im2col_tile << ";" << std::endl;
+
+		// im2col: col[(c*KH+k0)*KW+k1][p] is the input under kernel
+		// element k0,k1 of channel c, for output p0+p
+		INDT_2 << "for( uint32_t c=0; c<" << channels << "; c++ )" << std::endl;
+		INDT_2 << "for( uint32_t k0=0; k0<" << kernel_shape[0] << "; k0++ )" << std::endl;
+		INDT_2 << "for( uint32_t k1=0; k1<" << kernel_shape[1] << "; k1++ ) {" << std::endl;
+		INDT_3 << "float *patch = col[(c*" << kernel_shape[0] << "+k0)*" << kernel_shape[1] << "+k1];" << std::endl;
+		INDT_3 << "int32_t o0 = p0/" << out_w << ", o1 = p0%" << out_w << ";" << std::endl;
+		INDT_3 << "uint32_t p;" << std::endl;
+		INDT_3 << "for( p=0; p<np; p++ ) {" << std::endl;
+		INDT_4 << "int32_t ii0 = o0*" << strides[0] << " + k0*" << dilations[0] << " - " << pads[0] << ";" << std::endl;
+		INDT_4 << "int32_t ii1 = o1*" << strides[1] << " + k1*" << dilations[1] << " - " << pads[1] << ";" << std::endl;
+		INDT_4 << "patch[p] = ii0 >= 0 && ii0 < " << in_h << " && ii1 >= 0 && ii1 < " << in_w << " ? x[b][c][ii0][ii1] : 0;" << std::endl;
+		INDT_4 << "if( ++o1 == " << out_w << " ) { o1 = 0; o0++; }" << std::endl;
+		INDT_3 << "}" << std::endl;
+		// the last block of the last tile reads past np
+		INDT_3 << "for( ; p<" << im2col_tile << "; p++ )" << std::endl;
+		INDT_4 << "patch[p] = 0;" << std::endl;
+		INDT_2 << "}" << std::endl;
+
+		// GEMM: y[b][m][p0+p] = bias[m] + sum over k of w[m][k] * col[k][p]
+		INDT_2 << "for( uint32_t mb=0; mb<" << blocks << "; mb++ )" << std::endl;
+		INDT_2 << "for( uint32_t pc=0; pc<np; pc+=" << NR << " ) {" << std::endl;
+		INDT_3 << "float acc[" << MR << "][" << NR << "];" << std::endl;
+		INDT_3 << "for( uint32_t r=0; r<" << MR << "; r++ )" << std::endl;
+		INDT_3 << "for( uint32_t p=0; p<" << NR << "; p++ )" << std::endl;
+		INDT_4 << "acc[r][p] = ";
+		if( get_number_of_inputs() < 3 )
+			dst << "0;" << std::endl;
+		else if( maps % MR == 0 )
+			dst << "bias[mb*" << MR << "+r];" << std::endl;
+		else
+			dst << "mb*" << MR << "+r < " << maps << " ? bias[mb*" << MR << "+r] : 0;" << std::endl;
+		INDT_3 << "for( uint32_t k=0; k<" << K << "; k++ ) {" << std::endl;
+		if( im2col_packed_w )
+			INDT_4 << "const float *wk = w[mb][k];" << std::endl;
+		else
+			INDT_4 << "const float *wk = (const float*)w + mb*" << MR*K << " + k;" << std::endl;
+		INDT_4 << "const float *colk = col[k] + pc;" << std::endl;
+		INDT_4 << "for( uint32_t r=0; r<" << MR << "; r++ )" << std::endl;
+		INDT_4 << "for( uint32_t p=0; p<" << NR << "; p++ )" << std::endl;
+		INDT_5 << "acc[r][p] += wk[r" << (im2col_packed_w ? "" : "*" + std::to_string(K)) << "] * colk[p];" << std::endl;
+		INDT_3 << "}" << std::endl;
+		INDT_3 << "uint32_t n = np-pc < " << NR << " ? np-pc : " << NR << ";" << std::endl;
+		INDT_3 << "for( uint32_t r=0; r<" << MR << "; r++ ) {" << std::endl;
+		INDT_4 << "uint32_t m = mb*" << MR << "+r;" << std::endl;
+		if( maps % MR != 0 )
+			INDT_4 << "if( m >= " << maps << " ) break;" << std::endl;
+		INDT_4 << "float *yp = (float*)y[b][m] + p0 + pc;" << std::endl;
+		INDT_4 << "for( uint32_t p=0; p<n; p++ ) {" << std::endl;
+		INDT_5 << "float v = acc[r][p];" << std::endl;
+		activation.print_in_place(dst, "\t\t\t\t\t", "v");
+		INDT_5 << "yp[p] = v;" << std::endl;
+		INDT_4 << "}" << std::endl;
+		INDT_3 << "}" << std::endl;
+		INDT_2 << "}" << std::endl;
+		INDT_1 << "} /* p0 */" << std::endl;
+		INDT_1 << "} /* b */" << std::endl;
 	}
  
+	/* A depthwise convolution: each input channel has a filter of its
+	 * own, giving one output channel (group == C == M). */
+	bool is_depthwise(void) const
+	{
+		return get_numDataDim() == 2
+		    && group > 1
+		    && group == get_X()->data_dim[1]
+		    && group == get_Y()->data_dim[1]
+		    && options.quantize == false
+		    && get_X()->data_type == onnx::TensorProto_DataType_FLOAT
+		    && get_W()->data_type == onnx::TensorProto_DataType_FLOAT
+		    && kernel_shape[0] * kernel_shape[1] <= DEPTHWISE_MAX_KERNEL;
+	}
+
+	/* A pointwise convolution: 1x1 kernel, stride 1 and no padding.
+	 * Each output is a weighted sum of the input channels at the same
+	 * position, i.e. y[b] = w x[b] with w as a [M][C] and x[b]
+	 * as a [C][positions] matrix. */
+	bool is_pointwise(void) const
+	{
+		if( group != 1 || options.quantize
+		 || get_X()->data_type != onnx::TensorProto_DataType_FLOAT
+		 || get_W()->data_type != onnx::TensorProto_DataType_FLOAT )
+			return false;
+		for( unsigned i=0; i<get_numDataDim(); i++ )
+			if( kernel_shape[i] != 1 || strides[i] != 1
+			 || pads[i] != 0 || pads[i+get_numDataDim()] != 0 )
+				return false;
+		return true;
+	}
+
+	/* Pointwise convolution as a matrix multiplication, in blocks
+	 * of POINTWISE_MR output channels and POINTWISE_NR outputs.
+	 * The remaining rows and columns get smaller blocks. The inner
+	 * loops run over consecutive outputs. */
+	void print_pointwise(std::ostream &dst) const
+	{
+		unsigned batch_size = get_X()->data_dim[0];
+		unsigned maps = get_Y()->data_dim[1];
+		unsigned positions = 1;
+		for( unsigned i=0; i<get_numDataDim(); i++ )
+			positions *= get_Y()->data_dim[2+i];
+		unsigned full_maps = maps - maps % POINTWISE_MR;
+		unsigned full_positions = positions - positions % POINTWISE_NR;
+
+		INDT_1 << "for( uint32_t b=0; b<" << batch_size << "; b++ ) {" << std::endl;
+		INDT_2 << "const float *xb = (const float*)x[b];" << std::endl;
+		INDT_2 << "const float *wm = (const float*)w;" << std::endl;
+		INDT_2 << "float *yb = (float*)y[b];" << std::endl;
+		print_pointwise_blocks(dst, 0, full_maps, POINTWISE_MR, 0, full_positions, POINTWISE_NR);
+		print_pointwise_blocks(dst, 0, full_maps, POINTWISE_MR, full_positions, positions, positions - full_positions);
+		print_pointwise_blocks(dst, full_maps, maps, maps - full_maps, 0, full_positions, POINTWISE_NR);
+		print_pointwise_blocks(dst, full_maps, maps, maps - full_maps, full_positions, positions, positions - full_positions);
+		INDT_1 << "}" << std::endl;
+	}
+
+	private:
+	/* The blocks of mr output channels and nr outputs, covering
+	 * output channels m_from..m_to and outputs p_from..p_to */
+	void print_pointwise_blocks(std::ostream &dst, unsigned m_from, unsigned m_to, unsigned mr,
+	                            unsigned p_from, unsigned p_to, unsigned nr) const
+	{
+		if( m_from >= m_to || p_from >= p_to )
+			return;
+		unsigned channels = get_X()->data_dim[1];
+		unsigned positions = 1;
+		for( unsigned i=0; i<get_numDataDim(); i++ )
+			positions *= get_Y()->data_dim[2+i];
+
+		INDT_2 << "for( uint32_t m=" << m_from << "; m<" << m_to << "; m+=" << mr << " )" << std::endl;
+		INDT_2 << "for( uint32_t p=" << p_from << "; p<" << p_to << "; p+=" << nr << " ) {" << std::endl;
+		INDT_3 << "float acc[" << mr << "][" << nr << "];" << std::endl;
+		INDT_3 << "for( uint32_t r=0; r<" << mr << "; r++ )" << std::endl;
+		INDT_3 << "for( uint32_t j=0; j<" << nr << "; j++ )" << std::endl;
+		INDT_4 << "acc[r][j] = " << (get_number_of_inputs() < 3 ? "0" : "bias[m+r]") << ";" << std::endl;
+		INDT_3 << "for( uint32_t c=0; c<" << channels << "; c++ ) {" << std::endl;
+		INDT_4 << "const float *xc = xb + c*" << positions << " + p;" << std::endl;
+		INDT_4 << "for( uint32_t r=0; r<" << mr << "; r++ ) {" << std::endl;
+		INDT_5 << "float wr = wm[(m+r)*" << channels << " + c];" << std::endl;
+		INDT_5 << "for( uint32_t j=0; j<" << nr << "; j++ )" << std::endl;
+		INDT_5 << "\tacc[r][j] += wr * xc[j];" << std::endl;
+		INDT_4 << "}" << std::endl;
+		INDT_3 << "}" << std::endl;
+		INDT_3 << "for( uint32_t r=0; r<" << mr << "; r++ )" << std::endl;
+		INDT_3 << "for( uint32_t j=0; j<" << nr << "; j++ ) {" << std::endl;
+		INDT_4 << "float v = acc[r][j];" << std::endl;
+		activation.print_in_place(dst, "\t\t\t\t", "v");
+		INDT_4 << "yb[(m+r)*" << positions << " + p + j] = v;" << std::endl;
+		INDT_3 << "}" << std::endl;
+		INDT_2 << "}" << std::endl;
+	}
+
+	public:
+	/* Depthwise convolution, as a 2D stencil over each channel.
+	 * The outputs where the kernel is entirely within the input
+	 * have the kernel window unrolled, with the kernel in local
+	 * variables. The borders around them check for the padding. */
+	void print_depthwise(std::ostream &dst) const
+	{
+		unsigned batch_size = get_X()->data_dim[0];
+		unsigned channels = get_X()->data_dim[1];
+		int64_t out_h = get_Y()->data_dim[2];
+		int64_t first0, last0, first1, last1;
+		interior_outputs(0, first0, last0);
+		interior_outputs(1, first1, last1);
+		bool has_interior = first0 < last0 && first1 < last1;
+
+		INDT_1 << "for( uint32_t b=0; b<" << batch_size << "; b++ )" << std::endl;
+		INDT_1 << "for( uint32_t c=0; c<" << channels << "; c++ ) {" << std::endl;
+		if( has_interior ) {
+			for( int k0=0; k0<kernel_shape[0]; k0++ )
+			for( int k1=0; k1<kernel_shape[1]; k1++ )
+				INDT_2 << "float " << depthwise_weight(k0, k1) << " = w[c][0][" << k0 << "][" << k1 << "];" << std::endl;
+		}
+		if( has_interior == false )
+			print_depthwise_rows(dst, 0, out_h, false);
+		else {
+			if( first0 > 0 )
+				print_depthwise_rows(dst, 0, first0, false);
+			print_depthwise_rows(dst, first0, last0, true);
+			if( last0 < out_h )
+				print_depthwise_rows(dst, last0, out_h, false);
+		}
+		INDT_1 << "}" << std::endl;
+	}
+
+	private:
+	static std::string depthwise_weight(int k0, int k1)
+	{
+		return "w" + std::to_string(k0) + "_" + std::to_string(k1);
+	}
+
+	/* The rows from..to of a depthwise convolution. For the
+	 * interior rows, the columns are split into the borders and
+	 * the interior, whose outputs are calculated without checks. */
+	void print_depthwise_rows(std::ostream &dst, int64_t from, int64_t to, bool interior_rows) const
+	{
+		int64_t out_w = get_Y()->data_dim[3];
+		int64_t first1, last1;
+		interior_outputs(1, first1, last1);
+
+		print_output_loop(dst, 0, from, to);
+		if( interior_rows == false ) {
+			print_output_loop(dst, 1, 0, out_w);
+			print_depthwise_cell(dst, true);
+			INDT_2 << "}" << std::endl;
+		}
+		else {
+			if( first1 > 0 ) {
+				print_output_loop(dst, 1, 0, first1);
+				print_depthwise_cell(dst, true);
+				INDT_2 << "}" << std::endl;
+			}
+			print_output_loop(dst, 1, first1, last1);
+			print_depthwise_cell(dst, false);
+			INDT_2 << "}" << std::endl;
+			if( last1 < out_w ) {
+				print_output_loop(dst, 1, last1, out_w);
+				print_depthwise_cell(dst, true);
+				INDT_2 << "}" << std::endl;
+			}
+		}
+		INDT_2 << "}" << std::endl;
+	}
+
+	/* One output of a depthwise convolution, at o0,o1, whose
+	 * kernel window starts at i0,i1 of the input. The terms
+	 * are summed in the same order as in the generic loops. */
+	void print_depthwise_cell(std::ostream &dst, bool checked) const
+	{
+		INDT_3 << "float s = ";
+		if( get_number_of_inputs() < 3 )
+			dst << "0;" << std::endl;
+		else
+			dst << "bias[c];" << std::endl;
+		if( checked ) {
+			INDT_3 << "for( int32_t k0=0; k0<" << kernel_shape[0] << "; k0++ ) {" << std::endl;
+			INDT_4 << "int32_t ii0 = i0 + k0*" << dilations[0] << ";" << std::endl;
+			INDT_4 << "if( ii0 < 0 || ii0 >= " << get_X()->data_dim[2] << " ) continue;" << std::endl;
+			INDT_4 << "for( int32_t k1=0; k1<" << kernel_shape[1] << "; k1++ ) {" << std::endl;
+			INDT_5 << "int32_t ii1 = i1 + k1*" << dilations[1] << ";" << std::endl;
+			INDT_5 << "if( ii1 < 0 || ii1 >= " << get_X()->data_dim[3] << " ) continue;" << std::endl;
+			INDT_5 << "s += x[b][c][ii0][ii1] * w[c][0][k0][k1];" << std::endl;
+			INDT_4 << "}" << std::endl;
+			INDT_3 << "}" << std::endl;
+		}
+		else {
+			for( int k0=0; k0<kernel_shape[0]; k0++ )
+			for( int k1=0; k1<kernel_shape[1]; k1++ )
+				INDT_3 << "s += x[b][c][i0+" << k0*dilations[0] << "][i1+" << k1*dilations[1] << "] * "
+				       << depthwise_weight(k0, k1) << ";" << std::endl;
+		}
+		activation.print_in_place(dst, "\t\t\t", "s");
+		INDT_3 << "y[b][c][o0][o1] = s;" << std::endl;
+	}
+
+	public:
+	/* Calculate the outputs in m x m tiles, with the Winograd
+	 * transform F(mxm,3x3), winograd_tiles tiles at a time:
+	 * transform the input tiles of each channel into 'v', sum the
+	 * products with the transformed weights over the channels into
+	 * 'mt', and transform those back into the output tiles. */
+	void print_winograd(std::ostream &dst) const
+	{
+		const WinogradTransform &wt = WinogradTransform::get(winograd_m);
+		const unsigned m = wt.m, n = wt.n;
+		unsigned batch_size = get_X()->data_dim[0];
+		unsigned channels = get_X()->data_dim[1];
+		unsigned in_h = get_X()->data_dim[2];
+		unsigned in_w = get_X()->data_dim[3];
+		unsigned maps = get_Y()->data_dim[1];
+		unsigned out_h = get_Y()->data_dim[2];
+		unsigned out_w = get_Y()->data_dim[3];
+		unsigned tiles_w = (out_w + m - 1) / m;
+		unsigned tiles = (out_h + m - 1) / m * tiles_w;
+		std::string u = winograd_const_w ? "w" : "u";
+		auto idx = [](const std::string &a, unsigned i, unsigned j) {
+			return a + "[" + std::to_string(i) + "][" + std::to_string(j) + "]";
+		};
+
+		INDT_1 << "/* Winograd F(" << m << "x" << m << ",3x3) */" << std::endl;
+		if( winograd_const_w == false ) {
+			// u[i*n+j][m][c] = (G w[m][c] GT)[i][j]
+			INDT_1 << "for( uint32_t m=0; m<" << maps << "; m++ )" << std::endl;
+			INDT_1 << "for( uint32_t c=0; c<" << channels << "; c++ ) {" << std::endl;
+			INDT_2 << "float gt[" << n << "][3];" << std::endl;
+			for( unsigned i=0; i<n; i++ )
+			for( unsigned j=0; j<3; j++ ) {
+				std::vector<std::string> terms;
+				for( unsigned k=0; k<3; k++ )
+					terms.push_back("w[m][c][" + std::to_string(k) + "][" + std::to_string(j) + "]");
+				INDT_2 << idx("gt", i, j) << " = " << wt.linear_combination(wt.G[i], terms) << ";" << std::endl;
+			}
+			for( unsigned i=0; i<n; i++ )
+			for( unsigned j=0; j<n; j++ ) {
+				std::vector<std::string> terms;
+				for( unsigned k=0; k<3; k++ )
+					terms.push_back(idx("gt", i, k));
+				INDT_2 << "u[" << i*n+j << "][m][c] = " << wt.linear_combination(wt.G[j], terms) << ";" << std::endl;
+			}
+			INDT_1 << "}" << std::endl;
+		}
+
+		INDT_1 << "for( uint32_t b=0; b<" << batch_size << "; b++ )" << std::endl;
+		INDT_1 << "for( uint32_t t0=0; t0<" << tiles << "; t0+=" << winograd_tiles << " ) {" << std::endl;
+		INDT_2 << "uint32_t nt = " << tiles << "-t0 < " << winograd_tiles << " ? " << tiles << "-t0 : " << winograd_tiles << ";" << std::endl;
+
+		// v[i*n+j][c][t] = (BT d B)[i][j], d the input tile of tile t0+t
+		INDT_2 << "for( uint32_t c=0; c<" << channels << "; c++ )" << std::endl;
+		INDT_2 << "for( uint32_t t=0; t<nt; t++ ) {" << std::endl;
+		INDT_3 << "int32_t i0 = (t0+t)/" << tiles_w << "*" << m << " - " << pads[0] << ";" << std::endl;
+		INDT_3 << "int32_t i1 = (t0+t)%" << tiles_w << "*" << m << " - " << pads[1] << ";" << std::endl;
+		INDT_3 << "float d[" << n << "][" << n << "], bd[" << n << "][" << n << "];" << std::endl;
+		INDT_3 << "for( int32_t i=0; i<" << n << "; i++ )" << std::endl;
+		INDT_3 << "for( int32_t j=0; j<" << n << "; j++ ) {" << std::endl;
+		INDT_4 << "int32_t ii0 = i0+i, ii1 = i1+j;" << std::endl;
+		INDT_4 << "d[i][j] = ii0 >= 0 && ii0 < " << in_h << " && ii1 >= 0 && ii1 < " << in_w << " ? x[b][c][ii0][ii1] : 0;" << std::endl;
+		INDT_3 << "}" << std::endl;
+		for( unsigned i=0; i<n; i++ )
+		for( unsigned j=0; j<n; j++ ) {
+			std::vector<std::string> terms;
+			for( unsigned k=0; k<n; k++ )
+				terms.push_back(idx("d", k, j));
+			INDT_3 << idx("bd", i, j) << " = " << wt.linear_combination(wt.BT[i], terms) << ";" << std::endl;
+		}
+		for( unsigned i=0; i<n; i++ )
+		for( unsigned j=0; j<n; j++ ) {
+			std::vector<std::string> terms;
+			for( unsigned k=0; k<n; k++ )
+				terms.push_back(idx("bd", i, k));
+			INDT_3 << "v[" << i*n+j << "][c][t] = " << wt.linear_combination(wt.BT[j], terms) << ";" << std::endl;
+		}
+		INDT_2 << "}" << std::endl;
+
+		// mt[xi][m][t] = sum over c of u[xi][m][c] * v[xi][c][t]
+		INDT_2 << "for( uint32_t xi=0; xi<" << n*n << "; xi++ )" << std::endl;
+		INDT_2 << "for( uint32_t m=0; m<" << maps << "; m++ ) {" << std::endl;
+		INDT_3 << "float *mo = mt[xi][m];" << std::endl;
+		INDT_3 << "for( uint32_t t=0; t<nt; t++ )" << std::endl;
+		INDT_4 << "mo[t] = 0;" << std::endl;
+		INDT_3 << "for( uint32_t c=0; c<" << channels << "; c++ ) {" << std::endl;
+		INDT_4 << "float uc = " << u << "[xi][m][c];" << std::endl;
+		INDT_4 << "const float *vc = v[xi][c];" << std::endl;
+		INDT_4 << "for( uint32_t t=0; t<nt; t++ )" << std::endl;
+		INDT_5 << "mo[t] += uc * vc[t];" << std::endl;
+		INDT_3 << "}" << std::endl;
+		INDT_2 << "}" << std::endl;
+
+		// y tile = AT mt A
+		INDT_2 << "for( uint32_t m=0; m<" << maps << "; m++ )" << std::endl;
+		INDT_2 << "for( uint32_t t=0; t<nt; t++ ) {" << std::endl;
+		INDT_3 << "uint32_t o0 = (t0+t)/" << tiles_w << "*" << m << ";" << std::endl;
+		INDT_3 << "uint32_t o1 = (t0+t)%" << tiles_w << "*" << m << ";" << std::endl;
+		INDT_3 << "float am[" << m << "][" << n << "];" << std::endl;
+		for( unsigned i=0; i<m; i++ )
+		for( unsigned j=0; j<n; j++ ) {
+			std::vector<std::string> terms;
+			for( unsigned k=0; k<n; k++ )
+				terms.push_back("mt[" + std::to_string(k*n+j) + "][m][t]");
+			INDT_3 << idx("am", i, j) << " = " << wt.linear_combination(wt.AT[i], terms) << ";" << std::endl;
+		}
+		for( unsigned i=0; i<m; i++ )
+		for( unsigned j=0; j<m; j++ ) {
+			std::vector<std::string> terms;
+			for( unsigned k=0; k<n; k++ )
+				terms.push_back(idx("am", i, k));
+			std::string cond;
+			if( out_h % m != 0 && i > 0 )
+				cond += "o0+" + std::to_string(i) + " < " + std::to_string(out_h);
+			if( out_w % m != 0 && j > 0 )
+				cond += (cond == "" ? "" : " && ") + std::string("o1+") + std::to_string(j) + " < " + std::to_string(out_w);
+			if( cond != "" )
+				INDT_3 << "if( " << cond << " ) ";
+			else
+				INDT_3;
+			dst << "{" << std::endl;
+			INDT_4 << "float r = " << wt.linear_combination(wt.AT[j], terms);
+			if( get_number_of_inputs() > 2 )
+				dst << " + bias[m]";
+			dst << ";" << std::endl;
+			activation.print_in_place(dst, "\t\t\t\t", "r");
+			INDT_4 << "y[b][m][o0+" << i << "][o1+" << j << "] = r;" << std::endl;
+			INDT_3 << "}" << std::endl;
+		}
+		INDT_2 << "}" << std::endl;
+		INDT_1 << "} /* t0 */" << std::endl;
+	}
+
 	virtual void resolve(void) override
 	{
 		name_input(0,"x");
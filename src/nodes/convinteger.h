@@ -58,8 +58,11 @@ class ConvInteger : public SpatialFilter {
 			INDT_3 << "int32_t tmp = cell/" << divisor << ";" << std::endl;
 			INDT_3 << "tmp = tmp > 127?127:tmp;" << std::endl;
 			INDT_3 << "tmp = tmp < -127?-127:tmp;" << std::endl;
+			activation.print_in_place(dst, "\t\t\t", "tmp");
 			INDT_3 << "y[b][m][o0][o1] = tmp;" << std::endl;
 		}
+		else
+			activation.print_in_place(dst, "\t\t\t", "y[b][m][o0][o1]");
 	}
 
 
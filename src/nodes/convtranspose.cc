@@ -31,7 +31,7 @@
 namespace toC {
 
 
-void ConvTranspose::parseAttributes( onnx::NodeProto &node ) {
+void ConvTranspose::parseAttributes( const onnx::NodeProto &node ) {
 	for( const auto& a : node.attribute() ) {
 		if( a.name() == "auto_pad" )
 			auto_pad = parse_attribute_string(a);
@@ -41,7 +41,7 @@ class ConvTranspose : public Node {
 
 	bool output_shape_given; // [sic] - should be output_shape_given
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 
 	virtual void resolve(void) override;
 	std::vector<int> calculate_output_size(void);
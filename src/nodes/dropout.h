@@ -20,7 +20,7 @@ class Dropout : public Node {
 	int seed;
 	bool seed_given; //not an attribute
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "seed" ) {
 				seed = parse_attribute_int(a);
@@ -13,7 +13,7 @@ class DynamicQuantizeLinear : public Node {
 		op_name = "DynamicQuantizeLinear";
 	}
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			ERROR("DynamicQuantizeLinear should not have attributes, found" << a.name());
 		}
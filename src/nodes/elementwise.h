@@ -8,9 +8,9 @@
 namespace toC {
 
 class Elementwise : public Node {
+	public:
 	float alpha, beta, bias, gamma, lambd;
 
-	public:
 	Elementwise(std::string op) {
 		op_name = op;
 		alpha=beta=gamma=bias=0;
@@ -157,7 +157,7 @@ class Elementwise : public Node {
 
 	// NB: not all ONNX operators implemented with Elementwise have attributes.
 	// This gets the attributes over an union of all implemented operators
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "alpha" )
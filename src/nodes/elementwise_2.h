@@ -102,7 +102,7 @@ class Elementwise_2 : public Node {
 			ERROR("Elementwise_2 operand " + op + " not implemented");
 	}
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "direction" )
@@ -11,7 +11,7 @@ class Elementwise_variadic : public Node {
 	public:
 
 	// Each instance of this class should override this lambda with the operation of the node type.
-	// Inputs: the stream to print to and indexing arrays for each of the input vectors (padded for broadcasting)
+	// Inputs: the stream to print to and the indexed input elements (e.g. "in_0[i0][0]")
 	// See the implementations below for clarification :)
 	std::function<void (std::ostream &, const std::vector<std::string> &)> operation =
 		[](std::ostream &a, const std::vector<std::string> &b){ ERROR("onnx2c internal error"); };
@@ -21,45 +21,45 @@ class Elementwise_variadic : public Node {
 		op_name = op;
 
 		if( op == "Min" )
-			operation = [this](std::ostream &dst, const std::vector<std::string> &idxs)
+			operation = [this](std::ostream &dst, const std::vector<std::string> &ins)
 				{
 					const unsigned n_inp = get_number_of_inputs();
-					INDT_3 << "MIN(in_0" << idxs[0] << ", " << std::endl;
+					INDT_3 << "MIN(" << ins[0] << ", " << std::endl;
 					for(unsigned i=0; i<n_inp-1; i++)
-						INDT_3 << "MIN(in_" << i << idxs[i] << ", " << std::endl;
-					INDT_4 << "in_" << n_inp-1 << idxs[n_inp-1];
+						INDT_3 << "MIN(" << ins[i] << ", " << std::endl;
+					INDT_4 << ins[n_inp-1];
 					for(unsigned i=0; i<n_inp; i++)
 						dst << ")";
 					dst << ";" << std::endl;
 				};
 		else if( op == "Mean" )
-			operation = [this](std::ostream &dst, const std::vector<std::string> &idxs)
+			operation = [this](std::ostream &dst, const std::vector<std::string> &ins)
 				{
 					const unsigned n_inp = get_number_of_inputs();
-					INDT_3 << "(in_0" << idxs[0] << std::endl;
+					INDT_3 << "(" << ins[0] << std::endl;
 					for(unsigned i=1; i<n_inp; i++)
-						INDT_3 << " + in_" << i << idxs[i] << std::endl;
+						INDT_3 << " + " << ins[i] << std::endl;
 					INDT_3 << ")/" << n_inp << ";" << std::endl;
 				};
 		else if( op == "Max" )
-			operation = [this](std::ostream &dst, const std::vector<std::string> &idxs)
+			operation = [this](std::ostream &dst, const std::vector<std::string> &ins)
 				{
 					const unsigned n_inp = get_number_of_inputs();
-					INDT_3 << "MAX(in_0" << idxs[0] << ", " << std::endl;
+					INDT_3 << "MAX(" << ins[0] << ", " << std::endl;
 					for(unsigned i=0; i<n_inp-1; i++)
-						INDT_3 << "MAX(in_" << i << idxs[i] << ", " << std::endl;
-					INDT_4 << "in_" << n_inp-1 << idxs[n_inp-1];
+						INDT_3 << "MAX(" << ins[i] << ", " << std::endl;
+					INDT_4 << ins[n_inp-1];
 					for(unsigned i=0; i<n_inp; i++)
 						dst << ")";
 					dst << ";" << std::endl;
 				};
 		else if (op == "Sum" )
-			operation = [this](std::ostream &dst, const std::vector<std::string> &idxs)
+			operation = [this](std::ostream &dst, const std::vector<std::string> &ins)
 				{
 					const unsigned n_inp = get_number_of_inputs();
-					INDT_3 << "(in_0" << idxs[0] << std::endl;
+					INDT_3 << "(" << ins[0] << std::endl;
 					for(unsigned i=1; i<n_inp; i++)
-						INDT_3 << " + in_" << i << idxs[i] << std::endl;
+						INDT_3 << " + " << ins[i] << std::endl;
 					INDT_3 << ");" << std::endl;
 				};
 		else
@@ -67,7 +67,7 @@ class Elementwise_variadic : public Node {
 	}
 
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			ERROR("unknown attribute");
@@ -97,7 +97,9 @@ class Elementwise_variadic : public Node {
 			// TODO: this is a copy from earlier code. Feels like there might
 			// be a more elegant way of doing this.
 			for( unsigned i=0; i<get_number_of_inputs(); i++) {
+				// prepend dimensions of 0 (i.e. not indexed) to match the output's rank
 				std::vector<int> pads = get_input_tensor(i)->data_dim;
+				pads.insert(pads.begin(), out->rank() - pads.size(), 0);
 				std::string idx_str;
 				if (pads[r]==1)
 					idx_str += "[0]";
@@ -110,8 +112,11 @@ class Elementwise_variadic : public Node {
 		}
 
 		// apply operation over input tensors, for each output element separately.
+		std::vector<std::string> ins;
+		for( unsigned i=0; i<get_number_of_inputs(); i++)
+			ins.push_back("in_" + std::to_string(i) + in_idx_strs[i]);
 		INDT_2 << "output" << out_idx_str << " = " << std::endl;
-		operation( dst, in_idx_strs);
+		operation( dst, ins);
 
 		// Close loop over output dimensions
 		for( unsigned r=0; r<out->rank(); r++) {
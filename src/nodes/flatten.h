@@ -9,7 +9,7 @@ class Flatten : public Node {
 	}
 	int axis;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "axis" ) {
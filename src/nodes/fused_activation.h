@@ -0,0 +1,83 @@
+/* This file is part of onnx2c.
+ *
+ * An activation function (Relu, Clip, LeakyRelu, Sigmoid or HardSwish)
+ * fused into the node that calculates the activation's input.
+ * The node applies it to each output value before storing it,
+ * instead of the activation node doing another pass over the output.
+ * Set by the fuse_activations optimization pass.
+ */
+#pragma once
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace toC {
+
+class FusedActivation {
+	public:
+	std::string op_name; // empty, if no activation is fused
+	float alpha;
+	float beta;
+	float min, max; // for Clip
+
+	FusedActivation()
+	: alpha(0), beta(0),
+	  min(std::numeric_limits<float>::lowest()),
+	  max(std::numeric_limits<float>::max())
+	{}
+
+	bool is_set(void) const { return op_name != ""; }
+
+	/* Print the C expression of the activation applied to 'x'. E.g.
+	 * "(x>0 ? x : 0)". 'x' gets evaluated several times, so it must
+	 * not have side effects. */
+	void print(std::ostream &dst, const std::string &x) const
+	{
+		// The same calculation as the standalone nodes do
+		if( op_name == "Relu" )
+			dst << "(" << x << " > 0 ? " << x << " : 0)";
+		else if( op_name == "Clip" )
+			print_clip(dst, x);
+		else if( op_name == "LeakyRelu" )
+			dst << "(" << x << ">0 ? " << x << " : " << x << "*" << std::to_string(alpha) << ")";
+		else if( op_name == "Sigmoid" )
+			dst << "(1/(1+exp(-" << x << ")))";
+		else if( op_name == "HardSwish" )
+			dst << "(" << x << "*fmax(0, fmin(1, " << std::to_string(alpha) << "*" << x << "+" << std::to_string(beta) << ")))";
+		else
+			dst << x;
+	}
+
+	// Clip, leaving out the limits that don't limit anything
+	void print_clip(std::ostream &dst, const std::string &x) const
+	{
+		std::stringstream expr;
+		expr.precision(std::numeric_limits<float>::max_digits10);
+		expr << x;
+		if( max < std::numeric_limits<float>::max() ) {
+			std::string e = expr.str();
+			expr.str("");
+			expr << "MIN( " << e << ", " << max << ")";
+		}
+		if( min > std::numeric_limits<float>::lowest() ) {
+			std::string e = expr.str();
+			expr.str("");
+			expr << "MAX( " << e << ", " << min << ")";
+		}
+		dst << expr.str();
+	}
+
+	/* Print a statement applying the activation to 'y' in place,
+	 * if there is an activation. */
+	void print_in_place(std::ostream &dst, const std::string &indent, const std::string &y) const
+	{
+		if( is_set() == false )
+			return;
+		dst << indent << y << " = ";
+		print(dst, y);
+		dst << ";" << std::endl;
+	}
+};
+
+}
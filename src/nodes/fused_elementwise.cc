@@ -0,0 +1,128 @@
+/* This file is part of onnx2c.
+ *
+ * FusedElementwise node.
+ * A group of elementwise nodes calculated in a single loop.
+ */
+#include "fused_elementwise.h"
+#include "options.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "elementwise.h"
+#include "elementwise_2.h"
+#include "elementwise_variadic.h"
+
+namespace toC {
+
+FusedElementwise::FusedElementwise(const std::vector<Node*> &steps)
+	: steps(steps)
+{
+	op_name = "FusedElementwise";
+	onnx_name = steps.back()->onnx_name;
+	isResolved = true;
+
+	for( unsigned s=0; s<steps.size()-1; s++ )
+		intermediates.push_back(steps[s]->get_output_tensor(0));
+
+	// Everything else the steps read is an input to the whole group
+	std::vector<Tensor*> inputs;
+	for( auto n : steps ) {
+		for( unsigned i=0; i<n->get_number_of_inputs(); i++ ) {
+			Tensor *t = n->get_input_tensor(i);
+			if( t->is_used() == false )
+				continue;
+			if( std::find(intermediates.begin(), intermediates.end(), t) != intermediates.end() )
+				continue;
+			if( std::find(inputs.begin(), inputs.end(), t) != inputs.end() )
+				continue;
+			inputs.push_back(t);
+			register_input(t, "in_" + std::to_string(inputs.size()-1));
+		}
+	}
+	register_output(steps.back()->get_output_tensor(0), "Y");
+}
+
+FusedElementwise::~FusedElementwise()
+{
+	for( auto n : steps )
+		delete n;
+	for( auto t : intermediates )
+		delete t;
+}
+
+bool FusedElementwise::can_fuse(const Node *n)
+{
+	return dynamic_cast<const Elementwise*>(n) != nullptr
+	    || dynamic_cast<const Elementwise_2*>(n) != nullptr
+	    || dynamic_cast<const Elementwise_variadic*>(n) != nullptr;
+}
+
+std::string FusedElementwise::element(const Tensor *t) const
+{
+	for( unsigned s=0; s<intermediates.size(); s++ )
+		if( intermediates[s] == t )
+			return "t" + std::to_string(s);
+
+	unsigned i;
+	for( i=0; i<get_number_of_inputs(); i++ )
+		if( get_input_tensor(i) == t )
+			break;
+	if( i == get_number_of_inputs() )
+		ERROR("onnx2c internal error: tensor " << t->name << " is not an input of " << onnx_name);
+
+	// Broadcast the input like Elementwise_2 does: missing leading
+	// dimensions are left out, and dimensions of 1 are not looped over.
+	unsigned loop_rank = get_output_tensor(0)->rank();
+	std::string rv = "in_" + std::to_string(i);
+	for( unsigned d=0; d<t->rank(); d++ ) {
+		if( t->data_dim[d] == 1 )
+			rv += "[0]";
+		else
+			rv += "[i" + std::to_string(loop_rank - t->rank() + d) + "]";
+	}
+	return rv;
+}
+
+void FusedElementwise::print(std::ostream &dst) const
+{
+	const Tensor *Y = get_output_tensor(0);
+	INDT_1 << "/* Elementwise nodes fused into one loop:" << std::endl;
+	for( auto n : steps )
+		INDT_1 << "   " << n->op_name << " (" << n->onnx_name << ")" << std::endl;
+	INDT_1 << " */" << std::endl;
+
+	std::string Yidx = "Y";
+	for( unsigned r=0; r<Y->rank(); r++) {
+		std::string lv = "i" + std::to_string(r);
+		INDT_1 << "for (unsigned " << lv << "=0; " << lv << "<" << Y->data_dim[r] << "; " << lv << "++) {" << std::endl;
+		Yidx += "[" + lv + "]";
+	}
+
+	for( unsigned s=0; s<steps.size(); s++ ) {
+		const Node *n = steps[s];
+		std::string result;
+		if( s == steps.size()-1 )
+			result = Yidx;
+		else
+			result = intermediates[s]->data_type_str() + " t" + std::to_string(s);
+
+		if( auto e = dynamic_cast<const Elementwise*>(n) )
+			INDT_2 << result << " = " << e->operation(element(n->get_input_tensor(0))) << std::endl;
+		else if( auto e = dynamic_cast<const Elementwise_2*>(n) )
+			INDT_2 << result << " = " << e->operation(element(n->get_input_tensor(0)), element(n->get_input_tensor(1))) << std::endl;
+		else if( auto e = dynamic_cast<const Elementwise_variadic*>(n) ) {
+			std::vector<std::string> ins;
+			for( unsigned i=0; i<n->get_number_of_inputs(); i++ )
+				ins.push_back(element(n->get_input_tensor(i)));
+			INDT_2 << result << " = " << std::endl;
+			e->operation(dst, ins);
+		}
+	}
+
+	for( unsigned r=0; r<Y->rank(); r++) {
+		INDT_1 << "}" << std::endl;
+	}
+}
+
+} // namespace
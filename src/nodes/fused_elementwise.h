@@ -0,0 +1,39 @@
+/* This file is part of onnx2c.
+ *
+ * FusedElementwise node.
+ * Not an ONNX operator, but created by the elementwise fusion
+ * optimization pass from a group of Elementwise, Elementwise_2 and
+ * Elementwise_variadic nodes, where each node's output is used only by
+ * the following nodes in the group. All of these are calculated in a
+ * single loop over the output, and the intermediate values are kept
+ * in local variables instead of tensors.
+ */
+#pragma once
+#include "node.h"
+
+namespace toC {
+
+class FusedElementwise : public Node {
+	public:
+	/* 'steps' are the nodes to fuse, in the order they are calculated.
+	 * The last one's output is the output of this node. The fused node
+	 * takes ownership of the steps, and the tensors between them. */
+	FusedElementwise(const std::vector<Node*> &steps);
+	virtual ~FusedElementwise();
+
+	// Can node 'n' be a part of a FusedElementwise node
+	static bool can_fuse(const Node *n);
+
+	unsigned get_number_of_steps(void) const { return steps.size(); }
+
+	virtual void print(std::ostream &dst) const override;
+
+	private:
+	std::vector<Node*> steps;
+	// outputs of all but the last step
+	std::vector<Tensor*> intermediates;
+
+	// The C expression for the element of 't' at the loop indexes
+	std::string element(const Tensor *t) const;
+};
+} // namespace
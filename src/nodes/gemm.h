@@ -7,6 +7,7 @@
  * C need not be of size A*B, but must be
  * 'unidirectionally broadcastable' to A*B.
  */
+#include "fused_activation.h"
 namespace toC {
 
 class Gemm : public Node {
@@ -23,8 +24,11 @@ class Gemm : public Node {
 	int transA; // boolean for 'do the tranpose'
 	int transB;
 
+	// Applied to the output before storing it
+	FusedActivation activation;
+
 	/* Parse attributes, if this node has them. */
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 
@@ -163,6 +167,7 @@ class Gemm : public Node {
 			INDT_3 << "tmp = tmp < -127?-127:tmp;" << std::endl;
 		}
 
+		activation.print_in_place(dst, "\t\t\t", "tmp");
 		INDT_3 << "Y[r][c] = tmp;" << std::endl;
 
 		INDT_1 << "}" << std::endl;
@@ -23,14 +23,14 @@ class graph_io : public Node {
 	}
 
 	// Mandatory "API" functions towards the rest of onnx2c
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 	virtual void resolve(void) override;
 	virtual void print(std::ostream &dst) const override;
 };
 
 
 /* Parse attributes, if this node has them. */
-void graph_io::parseAttributes( onnx::NodeProto &node )
+void graph_io::parseAttributes( const onnx::NodeProto &node )
 {
 	// No attributes for special nodes
 }
@@ -14,7 +14,7 @@
 
 namespace toC {
 
-void InstanceNormalization::parseAttributes( onnx::NodeProto &node )
+void InstanceNormalization::parseAttributes( const onnx::NodeProto &node )
 {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
@@ -31,7 +31,7 @@ class InstanceNormalization : public Node {
 
 	virtual void print(std::ostream &dst) const override;
 	virtual void resolve(void) override;
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 };
 }
 
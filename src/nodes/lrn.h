@@ -27,7 +27,7 @@ class LRN : public Node {
 	int   size;
 
 	/* Parse attributes, if this node has them. */
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "alpha" )
@@ -19,7 +19,7 @@
 namespace toC {
 
 
-void LSTM::parseAttributes( onnx::NodeProto &node ) {
+void LSTM::parseAttributes( const onnx::NodeProto &node ) {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 
@@ -1,3 +1,4 @@
+#include "fused_activation.h"
 
 namespace toC {
 
@@ -7,6 +8,9 @@ class MatMul : public Node {
 		op_name = "MatMul";
 	}
 
+	// Applied to the output after calculating it
+	FusedActivation activation;
+
 	std::string vecstr( const std::vector<int>& vec ) const
 	{
 		std::stringstream result;
@@ -52,9 +56,15 @@ class MatMul : public Node {
 			INDT_1 << "/* MatMul */" << std::endl;
 			INDT_1 << "for( uint32_t r=0; r<" << rows << "; r++ )" << std::endl;
 			INDT_2 << "for( uint32_t c=0; c<" << cols << "; c++ ) {" << std::endl;
-			INDT_3 << "Y[r][c] = 0;" << std::endl;
+			// Not in the ONNX specification: the BatchNormalization
+			// folding can add a bias input.
+			if( get_number_of_inputs() > 2 )
+				INDT_3 << "Y[r][c] = bias[c];" << std::endl;
+			else
+				INDT_3 << "Y[r][c] = 0;" << std::endl;
 			INDT_3 << "for( uint32_t i=0; i<" << inner << "; i++ )" << std::endl;
 			INDT_4 << "Y[r][c] += A[r][i] * B[i][c];" << std::endl;
+			activation.print_in_place(dst, "\t\t\t", "Y[r][c]");
 			INDT_2 << "}" << std::endl;
 		}
 		else
@@ -71,6 +81,7 @@ class MatMul : public Node {
 			INDT_4 << "Y[n][r][c] = 0;" << std::endl;
 			INDT_4 << "for( uint32_t i=0; i<" << inner << "; i++ )" << std::endl;
 			INDT_5 << "Y[n][r][c] += " << A_txt << "[r][i] * " << B_txt << "[i][c];" << std::endl;
+			activation.print_in_place(dst, "\t\t\t\t", "Y[n][r][c]");
 			INDT_3 << "}" << std::endl;
 
 			INDT_1 << "}" << std::endl;
@@ -16,7 +16,7 @@ class MaxPool : public Pooling {
 
 	std::vector<int> pad_shapes;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		Pooling::parseAttributes(node);
 
@@ -7,7 +7,7 @@ namespace toC {
 
 
 /* Parse attributes, if this node has them. */
-void Pad::parseAttributes( onnx::NodeProto &node )
+void Pad::parseAttributes( const onnx::NodeProto &node )
 {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
@@ -30,7 +30,7 @@ class Pooling : public SpatialFilter {
 		return true;
 	}
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		SpatialFilter::parseAttributes(node);
 
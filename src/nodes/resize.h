@@ -29,7 +29,7 @@ class Resize : public Node {
 	std::vector<float>dim_scales; // 'scales' value when calculating coordinate transforms
 
 	/* Parse attributes, if this node has them. */
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "coordinate_transformation_mode" )
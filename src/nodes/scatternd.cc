@@ -8,7 +8,7 @@
 
 using namespace toC;
 
-void ScatterND::parseAttributes( onnx::NodeProto &node )
+void ScatterND::parseAttributes( const onnx::NodeProto &node )
 {
 	for( const auto& a : node.attribute() ) {
 		LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
@@ -14,7 +14,7 @@ class ScatterND : public Node {
 	}
 	std::string reduction;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override;
+	virtual void parseAttributes( const onnx::NodeProto &node ) override;
 	virtual void resolve(void) override;
 	virtual void print(std::ostream &dst) const override;
 };
@@ -25,7 +25,7 @@ class Slice : public Node {
 	std::vector<int64_t>ax;
 	std::vector<int64_t>stp;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			LOG(TRACE) << "Parsing attribute " << a.name() << std::endl;
 			if( a.name() == "axes" )
@@ -35,7 +35,7 @@ class Softmax : public Node {
 	// Axis to do the softmax on
 	int axis;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "axis" ) {
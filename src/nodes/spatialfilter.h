@@ -9,7 +9,9 @@
  */
 
 #pragma once
+#include <algorithm>
 #include "node.h"
+#include "fused_activation.h"
 namespace toC {
 
 class SpatialFilter : public Node {
@@ -28,6 +30,10 @@ class SpatialFilter : public Node {
 	std::vector<int64_t> pads;
 	std::vector<int64_t> strides;
 
+	// Activation applied to the output. Used by the child classes
+	// that calculate the output in print_output_cell_finalize().
+	FusedActivation activation;
+
 	const Tensor* get_X(void) const { return get_input_tensor(0); }
 	const Tensor* get_W(void) const {
 		if( get_number_of_inputs() > 1 )
@@ -38,7 +44,7 @@ class SpatialFilter : public Node {
 	const Tensor* get_Y(void) const { return get_output_tensor(0); }
 	uint32_t get_numDataDim(void) const {return get_X()->rank() - 2; }
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "auto_pad" )
 				auto_pad = parse_attribute_string(a);
@@ -178,10 +184,12 @@ class SpatialFilter : public Node {
 
 
 	/* Print the loops of the convolution.
-	 * This version has checks in the innermost loop for checking when
-	 * the kernel hits paddings.
-	 * This (probably, unless compliers are getting *real* amazing) causes
-	 * a lot of overhead. A.k.a. optmization opportunities.
+	 * Where the kernel can hit the paddings, there are checks in the
+	 * innermost loop to skip the padding. This causes a lot of overhead,
+	 * but only a thin border of the outputs needs them. So each output
+	 * dimension is split into the border before the interior, the
+	 * interior, and the border after it, each with a loop of its own.
+	 * Only the interior of all dimensions is calculated without any checks.
 	 *
 	 * Three callbacks to pure virtual functions are used:
 	 * - to initialize output cell
@@ -193,23 +201,10 @@ class SpatialFilter : public Node {
 	virtual void print_output_cell_finalize(std::ostream &dst, const std::string &y_idx="") const = 0;
 	void print_loop_with_padding_checks(std::ostream &dst) const
 	{
-		unsigned n_data_dims = get_numDataDim();
 		unsigned batch_size = get_X()->data_dim[0];
 		unsigned channels = get_X()->data_dim[1];
 		unsigned maps=get_Y()->data_dim[1];
 
-		/* Create various indexing strings. This makes generating the loops much cleaner,
-		 * and makes possible the code sharing in child classes. */
-		std::string x_idx = "[b][c]";
-		std::string in_kern_idxs = "[b][c]";
-		std::string y_idx = "[b][m]";
-		for( unsigned i = 0; i<n_data_dims; i++) {
-			std::string i_str = std::to_string(i);
-			x_idx += "[i" + i_str + "]";
-			y_idx += "[o" + i_str + "]";
-			in_kern_idxs += "[ii" + i_str + "]";
-		}
-
 		/* Create the loops over batches and channels.
 		 * In case this SpatialFilter has a weights input (w), this first loop is over
 		 * output channels (M). Othervise input channels==outputchannels, and it is named C
@@ -230,15 +225,99 @@ class SpatialFilter : public Node {
 		else
 			INDT_1 << "for( uint32_t m=0; m<" << maps << "; m++) {" << std::endl;
 
-
 		// loop over outputs and inputs
+		print_output_loops(dst, 0, get_numDataDim());
+
+		// close loops over batches and output channels
+		INDT_1 << "} /* m */" << std::endl;
+		if( direct_channel_map() == false && group > 1 )
+			INDT_2 << "} /* g */" << std::endl;
+		INDT_1 << "} /* b */" << std::endl;
+	}
+
+	protected:
+	/* The outputs of dimension 'dim' for which the kernel is
+	 * entirely within the input, i.e. doesn't hit the padding:
+	 * from 'first' to (but not including) 'last'. */
+	void interior_outputs(unsigned dim, int64_t &first, int64_t &last) const
+	{
+		int64_t in_size = get_X()->data_dim[2+dim];
+		int64_t out_size = get_Y()->data_dim[2+dim];
+		int64_t filter_size = (kernel_shape[dim]-1)*dilations[dim] + 1;
+		// The first output whose first input is not before the input,
+		// and the one after the last whose last input is not after it
+		first = (pads[dim] + strides[dim] - 1) / strides[dim];
+		int64_t last_start = in_size - filter_size + pads[dim];
+		last = last_start < 0 ? 0 : last_start / strides[dim] + 1;
+		first = std::min(first, out_size);
+		last = std::min(last, out_size);
+	}
+
+	// Loop over outputs from..to of dimension 'dim', and the corresponding inputs
+	void print_output_loop(std::ostream &dst, unsigned dim, int64_t from, int64_t to) const
+	{
+		std::string o_idx = "o" + std::to_string(dim);
+		std::string i_idx = "i" + std::to_string(dim);
+		INDT_2 << "for( int32_t " << o_idx << "=" << from << ", ";
+		   dst <<       i_idx << "=" << from * strides[dim] - pads[dim] << "; ";
+		   dst <<       o_idx << "<" << to << "; ";
+		   dst <<       o_idx <<"++, "<< i_idx << "+=" << strides[dim] << ") {" << std::endl;
+	}
+
+	private:
+
+	/* Print the loops over the output dimensions 'dim' and up.
+	 * The dimensions before 'dim' are checked from 'checked_from' up
+	 * (get_numDataDim() for none). While none are checked, the
+	 * dimension is split into the borders and the interior. */
+	void print_output_loops(std::ostream &dst, unsigned dim, unsigned checked_from) const
+	{
+		unsigned n_data_dims = get_numDataDim();
+		if( dim == n_data_dims ) {
+			print_output_cell(dst, checked_from);
+			return;
+		}
+
+		int64_t out_size = get_Y()->data_dim[2+dim];
+		int64_t first, last;
+		interior_outputs(dim, first, last);
+		if( checked_from < dim || first >= last ) {
+			// No interior, or already checking: the whole dimension with checks
+			print_output_loop(dst, dim, 0, out_size);
+			print_output_loops(dst, dim+1, std::min(checked_from, dim));
+			INDT_2 << "} /* o */" << std::endl;
+			return;
+		}
+		if( first > 0 ) {
+			print_output_loop(dst, dim, 0, first);
+			print_output_loops(dst, dim+1, dim);
+			INDT_2 << "} /* o */" << std::endl;
+		}
+		print_output_loop(dst, dim, first, last);
+		print_output_loops(dst, dim+1, checked_from);
+		INDT_2 << "} /* o */" << std::endl;
+		if( last < out_size ) {
+			print_output_loop(dst, dim, last, out_size);
+			print_output_loops(dst, dim+1, dim);
+			INDT_2 << "} /* o */" << std::endl;
+		}
+	}
+
+	/* Calculate one output cell. The kernel is checked
+	 * for hitting the padding in dimensions 'checked_from' and up. */
+	void print_output_cell(std::ostream &dst, unsigned checked_from) const
+	{
+		unsigned n_data_dims = get_numDataDim();
+		unsigned channels = get_X()->data_dim[1];
+
+		/* Create various indexing strings. This makes generating the loops much cleaner,
+		 * and makes possible the code sharing in child classes. */
+		std::string in_kern_idxs = "[b][c]";
+		std::string y_idx = "[b][m]";
 		for( unsigned i = 0; i<n_data_dims; i++) {
-			std::string o_idx = "o" + std::to_string(i);
-			std::string i_idx = "i" + std::to_string(i);
-			INDT_2 << "for( int32_t " << o_idx << "=0, ";
-			   dst <<       i_idx << "=" << -pads[i] << "; ";
-			   dst <<       o_idx << "<" << get_Y()->data_dim[2+i] << "; ";
-			   dst <<       o_idx <<"++, "<< i_idx << "+=" << strides[i] << ") {" << std::endl;
+			std::string i_str = std::to_string(i);
+			y_idx += "[o" + i_str + "]";
+			in_kern_idxs += "[ii" + i_str + "]";
 		}
 
 		print_output_cell_init(dst, y_idx);
@@ -262,6 +341,8 @@ class SpatialFilter : public Node {
 		for( unsigned i = 0; i<n_data_dims; i++) {
 			std::string i_str = std::to_string(i);
 			INDT_4 <<  "int ii" << i_str << " = i" << i_str << "+k" << i_str <<" * " << dilations[i] <<";" << std::endl;
+			if( i < checked_from )
+				continue;
 			INDT_4 <<  "if( ii" << i_str << "<0) continue;" << std::endl;
 			INDT_4 <<  "if( ii" << i_str << ">=" << get_X()->data_dim[2+i] << ") continue;" << std::endl;
 		}
@@ -276,16 +357,6 @@ class SpatialFilter : public Node {
 		if( direct_channel_map() == false )
 			INDT_3 << "} /* c */" << std::endl;
 		print_output_cell_finalize(dst, y_idx);
-
-		// close output loop
-		for( unsigned i = 0; i<n_data_dims; i++)
-			INDT_2 << "} /* o */" << std::endl;
-
-		// close loops over batches and output channels
-		INDT_1 << "} /* m */" << std::endl;
-		if( direct_channel_map() == false && group > 1 )
-			INDT_2 << "} /* g */" << std::endl;
-		INDT_1 << "} /* b */" << std::endl;
 	}
 };
 }
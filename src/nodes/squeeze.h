@@ -14,7 +14,7 @@ class Squeeze : public Node {
 
 	std::vector<int64_t> axes;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override
+	virtual void parseAttributes( const onnx::NodeProto &node ) override
 	{
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "axes" )
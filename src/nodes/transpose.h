@@ -11,7 +11,7 @@ class Transpose : public Node {
 	}
 	std::vector<int> perm;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 
 		for( const auto& a : node.attribute() ) {
 			if( a.name() == "perm" ) {
@@ -14,7 +14,7 @@ class Unsqueeze : public Node {
 
 	std::vector<int64_t> axes_attr;
 
-	virtual void parseAttributes( onnx::NodeProto &node ) override {
+	virtual void parseAttributes( const onnx::NodeProto &node ) override {
 		// In ONNX versions before 12, the axes were passed as a node,
 		// in 13 this was changed to pass as a input tensor.
 		// TODO: if onnx2c handles ONNX versions, maybe re-write this?
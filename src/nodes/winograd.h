@@ -0,0 +1,124 @@
+/* This file is part of onnx2c.
+ *
+ * Winograd minimal filtering F(mxm, 3x3): a 3x3 convolution of an
+ * n x n tile of the input (n = m+2) giving an m x m tile of the output as
+ *   Y = AT [ (G g GT) .* (BT d B) ] A
+ * where g is the 3x3 kernel and d the input tile. Summed over the
+ * input channels, the elementwise product is all that is left to do
+ * per channel, with n*n instead of m*m*9 multiplications.
+ * Used by the Conv node, when the winograd_convolutions optimization
+ * pass selects it.
+ */
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "error.h"
+
+namespace toC {
+
+class WinogradTransform {
+	public:
+	unsigned m; // outputs per tile side
+	unsigned n; // inputs per tile side
+	std::vector<std::vector<double>> BT; // n x n, input transform
+	std::vector<std::vector<double>> G;  // n x 3, kernel transform
+	std::vector<std::vector<double>> AT; // m x n, output transform
+
+	// The transforms of F(2x2,3x3) and F(4x4,3x3), as in
+	// Lavin & Gray: Fast Algorithms for Convolutional Neural Networks.
+	static const WinogradTransform& get(unsigned m)
+	{
+		static const WinogradTransform f2 = { 2, 4,
+			{ { 1,  0, -1,  0 },
+			  { 0,  1,  1,  0 },
+			  { 0, -1,  1,  0 },
+			  { 0,  1,  0, -1 } },
+			{ { 1,    0,   0   },
+			  { 0.5,  0.5, 0.5 },
+			  { 0.5, -0.5, 0.5 },
+			  { 0,    0,   1   } },
+			{ { 1, 1,  1,  0 },
+			  { 0, 1, -1, -1 } }
+		};
+		static const WinogradTransform f4 = { 4, 6,
+			{ { 4,  0, -5,  0, 1, 0 },
+			  { 0, -4, -4,  1, 1, 0 },
+			  { 0,  4, -4, -1, 1, 0 },
+			  { 0, -2, -1,  2, 1, 0 },
+			  { 0,  2, -1, -2, 1, 0 },
+			  { 0,  4,  0, -5, 0, 1 } },
+			{ {  1.0/4,      0,       0     },
+			  { -1.0/6, -1.0/6,  -1.0/6     },
+			  { -1.0/6,  1.0/6,  -1.0/6     },
+			  {  1.0/24, 1.0/12,  1.0/6     },
+			  {  1.0/24,-1.0/12,  1.0/6     },
+			  {  0,      0,       1         } },
+			{ { 1, 1,  1, 1,  1, 0 },
+			  { 0, 1, -1, 2, -2, 0 },
+			  { 0, 1,  1, 4,  4, 0 },
+			  { 0, 1, -1, 8, -8, 1 } }
+		};
+		if( m == 2 )
+			return f2;
+		if( m == 4 )
+			return f4;
+		ERROR("No Winograd transform for F(" << m << "x" << m << ",3x3)");
+	}
+
+	/* Transform the kernels w [maps][channels][3][3] into
+	 * u [n*n][maps][channels], u[i*n+j][m][c] = (G w[m][c] GT)[i][j].
+	 * Calculated in double, so the only rounding is to the result. */
+	void transform_weights(const float *w, float *u, unsigned maps, unsigned channels) const
+	{
+		for( unsigned mc=0; mc<maps*channels; mc++ ) {
+			const float *g = w + mc*9;
+			for( unsigned i=0; i<n; i++ )
+			for( unsigned j=0; j<n; j++ ) {
+				double sum = 0;
+				for( unsigned k=0; k<3; k++ )
+				for( unsigned l=0; l<3; l++ )
+					sum += G[i][k] * g[k*3+l] * G[j][l];
+				u[(i*n+j)*maps*channels + mc] = sum;
+			}
+		}
+	}
+
+	static std::string float_literal(double c)
+	{
+		std::stringstream lit;
+		lit.precision(std::numeric_limits<float>::max_digits10);
+		lit << (float)c;
+		std::string s = lit.str();
+		if( s.find_first_of(".e") == std::string::npos )
+			s += ".0";
+		return s + "f";
+	}
+
+	/* The C expression of the sum of coef[k]*terms[k], leaving
+	 * out the zero coefficients and multiplications by one. */
+	static std::string linear_combination(const std::vector<double> &coef, const std::vector<std::string> &terms)
+	{
+		std::stringstream expr;
+		bool first = true;
+		for( unsigned k=0; k<coef.size(); k++ ) {
+			double c = coef[k];
+			if( c == 0 )
+				continue;
+			if( first )
+				expr << (c < 0 ? "-" : "");
+			else
+				expr << (c < 0 ? " - " : " + ");
+			if( c != 1 && c != -1 )
+				expr << float_literal(c < 0 ? -c : c) << "*";
+			expr << terms[k];
+			first = false;
+		}
+		if( first )
+			return "0";
+		return expr.str();
+	}
+};
+}
@@ -0,0 +1,70 @@
+/* This file is part of onnx2c.
+ *
+ * Alias views optimization pass.
+ * Reshape, Flatten, Squeeze, Unsqueeze and (inference time) Dropout
+ * don't change the data, only how it is indexed. Instead of copying
+ * the input into the output, make the output tensor an alias of the
+ * input: a cast of the input's memory to the output's shape. The nodes
+ * are removed, so no function is generated for them.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+
+using namespace toC;
+
+static bool is_view_op(const std::string &op)
+{
+	return op == "Reshape"
+	    || op == "Flatten"
+	    || op == "Squeeze"
+	    || op == "Unsqueeze"
+	    || op == "Dropout";
+}
+
+void Graph::alias_view_nodes(void)
+{
+	LOG(INFO) << "Running Alias views optimization pass" << std::endl;
+	PassTimer timer("alias views");
+
+	unsigned num_aliased = 0;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		Node *n = nodes[i];
+		if( is_view_op(n->op_name) == false )
+			continue;
+		// Dropout's mask is calculated
+		if( n->op_name == "Dropout" && n->is_output_N_used(1) )
+			continue;
+
+		Tensor *x = n->get_input_tensor(0);
+		Tensor *y = n->get_output_tensor(0);
+		// Graph outputs are buffers from the caller, and must be written to
+		if( y->is_used() == false || y->isIO || y->isRecursive || x->isRecursive )
+			continue;
+		if( x->data_type != y->data_type || x->data_num_elem() != y->data_num_elem() )
+			continue;
+
+		LOG(DEBUG) << "\t" << y->cname() << " is a view of " << x->cname() << std::endl;
+		y->isAliasOf = x;
+
+		for( unsigned j=0; j<n->get_number_of_inputs(); j++ ) {
+			Tensor *t = n->get_input_tensor(j);
+			auto &c = t->consumers;
+			c.erase(std::remove(c.begin(), c.end(), n), c.end());
+			// e.g. Reshape's 'shape'
+			if( j > 0 && c.size() == 0 && t->isIO == false && t->initialize )
+				t->generate = false;
+		}
+		if( findNodeByName(n->onnx_name) == n )
+			node_index.erase(n->onnx_name);
+		nodes.erase(nodes.begin() + i);
+		i--;
+		delete n;
+		num_aliased++;
+	}
+
+	LOG(INFO) << "Replaced " << num_aliased << " nodes with tensor aliases" << std::endl;
+	timer.set_items(num_aliased);
+}
@@ -0,0 +1,80 @@
+/* This file is part of onnx2c.
+ *
+ * Dedupe Tensors optimization pass.
+ * Exported models often have many byte-identical constants:
+ * repeated biases, shape vectors, weights duplicated by graph
+ * surgery. Generate only one copy of each.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+using namespace toC;
+
+// Only constants that would be printed as global, initialized arrays
+static bool can_be_deduped(const Tensor *t)
+{
+	return t->generate
+	    && t->initialize
+	    && t->isConst
+	    && t->isIO == false
+	    && t->union_no < 0
+	    && t->isAliasOf == nullptr
+	    && t->name != ""
+	    && t->data_buffer != nullptr
+	    && t->data_num_elem() > 0;
+}
+
+static bool same_contents(const Tensor *a, const Tensor *b)
+{
+	if( a->data_type != b->data_type || a->data_dim != b->data_dim )
+		return false;
+	return memcmp(a->data_buffer, b->data_buffer, (size_t)a->data_num_elem() * a->data_elem_size()) == 0;
+}
+
+void Graph::dedupe_tensors(void)
+{
+	LOG(INFO) << "Running Dedupe tensors optimization pass" << std::endl;
+	PassTimer timer("dedupe tensors");
+
+	// Tensors by a hash of their contents. The first tensor with
+	// some contents is kept, and the later ones made aliases of it.
+	std::unordered_multimap<size_t, Tensor*> originals;
+	unsigned num_deduped = 0;
+	deduped_bytes = 0;
+	for( auto t : tensors ) {
+		if( can_be_deduped(t) == false )
+			continue;
+
+		size_t size = (size_t)t->data_num_elem() * t->data_elem_size();
+		size_t hash = std::hash<std::string_view>{}(
+			std::string_view(static_cast<const char*>(t->data_buffer), size));
+		hash ^= std::hash<std::string>{}(t->data_type_str() + t->str_dimensions());
+
+		Tensor *orig = nullptr;
+		auto range = originals.equal_range(hash);
+		for( auto it = range.first; it != range.second; it++ )
+			if( same_contents(it->second, t) ) {
+				orig = it->second;
+				break;
+			}
+
+		if( orig == nullptr ) {
+			originals.emplace(hash, t);
+			continue;
+		}
+
+		LOG(DEBUG) << "\t" << t->cname() << " is a duplicate of " << orig->cname() << std::endl;
+		t->isAliasOf = orig;
+		num_deduped++;
+		deduped_bytes += size;
+	}
+
+	LOG(INFO) << "Deduplicated " << num_deduped << " constant tensors, saving "
+	          << deduped_bytes << " bytes" << std::endl;
+	timer.set_items(num_deduped);
+}
@@ -0,0 +1,217 @@
+/* This file is part of onnx2c.
+ *
+ * Fold BatchNormalization optimization pass.
+ * In inference, BatchNormalization is an affine transformation
+ * per channel:
+ *   y = x * s + t,  s = scale / sqrt(var + epsilon),  t = bias - mean * s
+ * When x is calculated by a Conv, ConvTranspose, Gemm or MatMul with
+ * constant weights, s can be multiplied into the weights and t
+ * into the bias. The BatchNormalization node, and the tensor between
+ * the two nodes, are then removed.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <cmath>
+
+#include "nodes/batchnormalization.h"
+#include "nodes/convtranspose.h"
+#include "nodes/gemm.h"
+
+using namespace toC;
+
+static bool is_float_constant(const Tensor *t)
+{
+	return t->isConst
+	    && t->isIO == false
+	    && t->data_buffer != nullptr
+	    && t->data_type == onnx::TensorProto_DataType_FLOAT;
+}
+
+Tensor* Graph::add_folded_bias(Node *n, const std::string &name, const std::vector<int> &dims)
+{
+	Tensor *t = new Tensor;
+	t->name = name;
+	t->data_dim = dims;
+	t->data_type = onnx::TensorProto_DataType_FLOAT;
+	t->isConst = true;
+	t->initialize = true;
+	t->data_buffer = calloc(t->data_num_elem(), sizeof(float));
+	if( t->data_buffer == nullptr )
+		ERROR("memory allocation failed for tensor " << name);
+	t->consumers.push_back(n);
+	tensors.push_back(t);
+	indexTensor(t);
+	return t;
+}
+
+bool Graph::fold_batchnormalization_into(BatchNormalization *bn, Node *p)
+{
+	const Tensor *scale = bn->get_input_tensor(1);
+	const Tensor *shift = bn->get_input_tensor(2);
+	const Tensor *mean = bn->get_input_tensor(3);
+	const Tensor *var = bn->get_input_tensor(4);
+	unsigned num_chan = scale->data_num_elem();
+	Tensor *w = p->get_input_tensor(1);
+	if( is_modifiable_constant(w, p) == false )
+		return false;
+
+	// The per-channel multiplier and addend
+	std::vector<float> s(num_chan), t(num_chan);
+	for( unsigned c=0; c<num_chan; c++ ) {
+		float sd = ((float*)var->data_buffer)[c];
+		if( bn->sqrt_var_offline == false )
+			sd = sqrt(sd + bn->epsilon);
+		s[c] = ((float*)scale->data_buffer)[c] / sd;
+		t[c] = ((float*)shift->data_buffer)[c] - ((float*)mean->data_buffer)[c] * s[c];
+	}
+
+	Tensor *bias = p->get_number_of_inputs() > 2 ? p->get_input_tensor(2) : nullptr;
+	if( bias && is_modifiable_constant(bias, p) == false )
+		return false;
+	float *wd = (float*)w->data_buffer;
+	std::string bias_name = bn->get_output_tensor(0)->name + "_folded_bias";
+
+	if( p->op_name == "Conv" ) {
+		// w is [M][C/group][kernel...], and the bias [M]
+		if( (unsigned)w->data_dim[0] != num_chan )
+			return false;
+		if( bias == nullptr ) {
+			bias = add_folded_bias(p, bias_name, {(int)num_chan});
+			p->register_input(bias, "bias");
+		}
+		unsigned filter_size = w->data_num_elem() / num_chan;
+		for( unsigned m=0; m<num_chan; m++ )
+			for( unsigned i=0; i<filter_size; i++ )
+				wd[m*filter_size + i] *= s[m];
+	}
+	else if( p->op_name == "ConvTranspose" ) {
+		// w is [C][M][kernel...]. onnx2c implements only group=1.
+		ConvTranspose *ct = static_cast<ConvTranspose*>(p);
+		if( ct->group != 1 || (unsigned)w->data_dim[1] != num_chan )
+			return false;
+		if( bias == nullptr ) {
+			bias = add_folded_bias(p, bias_name, {(int)num_chan});
+			p->register_input(bias, "bias");
+			ct->b = bias;
+		}
+		unsigned filter_size = w->data_num_elem() / w->data_dim[0] / num_chan;
+		for( int c=0; c<w->data_dim[0]; c++ )
+			for( unsigned m=0; m<num_chan; m++ )
+				for( unsigned i=0; i<filter_size; i++ )
+					wd[(c*num_chan + m)*filter_size + i] *= s[m];
+	}
+	else if( p->op_name == "Gemm" || p->op_name == "MatMul" ) {
+		// The channels are the columns of B, and the output
+		int transB = 0;
+		if( p->op_name == "Gemm" )
+			transB = static_cast<Gemm*>(p)->transB;
+		else if( p->get_input_tensor(0)->rank() != 2 || w->rank() != 2 )
+			return false;
+		unsigned N = transB ? w->data_dim[0] : w->data_dim[1];
+		unsigned K = transB ? w->data_dim[1] : w->data_dim[0];
+		if( N != num_chan )
+			return false;
+
+		if( p->op_name == "Gemm" ) {
+			Gemm *gemm = static_cast<Gemm*>(p);
+			// Y = alpha*A*B + beta*C. Bias each column through C.
+			if( bias && gemm->beta == 0 )
+				return false;
+			if( bias == nullptr ) {
+				bias = add_folded_bias(p, bias_name, {1, (int)num_chan});
+				p->register_input(bias, "C");
+				gemm->beta = 1;
+			}
+			else if( num_chan > 1 ) {
+				// C must already be per column. (Gemm takes a 1D C
+				// with M elements to be per row, even if M==N)
+				const Tensor *A = p->get_input_tensor(0);
+				int M = gemm->transA ? A->data_dim[1] : A->data_dim[0];
+				if( bias->data_dim.back() != (int)num_chan )
+					return false;
+				if( bias->rank() == 1 && M == (int)num_chan )
+					return false;
+			}
+		}
+		else {
+			bias = add_folded_bias(p, bias_name, {(int)num_chan});
+			p->register_input(bias, "bias");
+		}
+
+		for( unsigned k=0; k<K; k++ )
+			for( unsigned n=0; n<N; n++ )
+				wd[transB ? n*K + k : k*N + n] *= s[n];
+	}
+	else
+		return false;
+
+	// Conv's and MatMul's bias is added as is. Gemm's C gets multiplied by beta.
+	float beta = p->op_name == "Gemm" ? static_cast<Gemm*>(p)->beta : 1;
+	float *bd = (float*)bias->data_buffer;
+	unsigned rows = bias->data_num_elem() / num_chan;
+	for( unsigned r=0; r<rows; r++ )
+		for( unsigned c=0; c<num_chan; c++ )
+			bd[r*num_chan + c] = bd[r*num_chan + c] * s[c] + t[c] / beta;
+	return true;
+}
+
+void Graph::fold_batchnormalization(void)
+{
+	LOG(INFO) << "Running Fold BatchNormalization optimization pass" << std::endl;
+	PassTimer timer("fold batchnormalization");
+
+	// Which node calculates each tensor
+	std::unordered_map<const Tensor*, Node*> producer;
+	for( auto n : nodes )
+		n->forEachOutput([&producer, n](Tensor *t) { producer[t] = n; });
+
+	unsigned num_folded = 0;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		if( nodes[i]->op_name != "BatchNormalization" )
+			continue;
+		BatchNormalization *bn = static_cast<BatchNormalization*>(nodes[i]);
+		if( bn->get_number_of_outputs() != 1 )
+			continue;
+		bool params_known = true;
+		for( unsigned p=1; p<5; p++ )
+			params_known &= is_float_constant(bn->get_input_tensor(p));
+		if( params_known == false )
+			continue;
+
+		// The folded-away tensor must be only for this BatchNormalization
+		Tensor *x = bn->get_input_tensor(0);
+		auto prod = producer.find(x);
+		if( prod == producer.end() || prod->second->get_number_of_outputs() != 1 )
+			continue;
+		if( x->isIO || x->consumers.size() != 1 )
+			continue;
+		Node *prev = prod->second;
+		if( prev->op_name != "Conv"
+		 && prev->op_name != "ConvTranspose"
+		 && prev->op_name != "Gemm"
+		 && prev->op_name != "MatMul" )
+			continue;
+		if( prev->get_input_tensor(0)->data_type != onnx::TensorProto_DataType_FLOAT )
+			continue;
+
+		if( fold_batchnormalization_into(bn, prev) == false ) {
+			LOG(DEBUG) << "\tcould not fold " << bn->onnx_name << " into " << prev->op_name << " " << prev->onnx_name << std::endl;
+			continue;
+		}
+		LOG(DEBUG) << "\tfolded " << bn->onnx_name << " into " << prev->op_name << " " << prev->onnx_name << std::endl;
+
+		// prev now calculates what the BatchNormalization did
+		Tensor *y = bn->get_output_tensor(0);
+		merge_into_producer(bn, prev);
+		producer[y] = prev;
+		if( prev->op_name == "ConvTranspose" )
+			static_cast<ConvTranspose*>(prev)->y = y;
+		i--;
+		num_folded++;
+	}
+
+	LOG(INFO) << "Folded " << num_folded << " BatchNormalization nodes" << std::endl;
+	timer.set_items(num_folded);
+}
@@ -0,0 +1,308 @@
+/* This file is part of onnx2c.
+ *
+ * Fold Constants optimization pass.
+ * Exported models compute shapes at run time with chains like
+ * Shape->Gather->Unsqueeze->Concat->Reshape. In onnx2c all shapes are
+ * known at compile time, so evaluate such nodes already here, and
+ * make their outputs initialized constant tensors. The nodes are
+ * left out of the generated code.
+ *
+ * Unlike the other passes, this runs while the graph is being
+ * resolved: e.g. Reshape needs its 'shape' input's values in resolve().
+ */
+#include "graph.h"
+#include "options.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "nodes/concat.h"
+#include "nodes/constantofshape.h"
+#include "nodes/gather.h"
+#include "nodes/range.h"
+
+using namespace toC;
+
+// Tensors that have a value known at compile time, and are
+// not passed in from the user (graph inputs are marked const too)
+static bool is_compile_time_constant(const Tensor *t)
+{
+	return t->isConst
+	    && t->isIO == false
+	    && t->isRecursive == false
+	    && t->data_buffer != nullptr;
+}
+
+// Nodes that just reinterpret the shape of their input
+static bool is_reshaping_op(const std::string &op)
+{
+	return op == "Reshape"
+	    || op == "Flatten"
+	    || op == "Squeeze"
+	    || op == "Unsqueeze";
+}
+
+static bool evaluate_gather(const Gather *n, char *out)
+{
+	const Tensor *data = n->get_input_tensor(0);
+	const Tensor *indices = n->get_input_tensor(1);
+	if( indices->data_type != onnx::TensorProto_DataType_INT32
+	 && indices->data_type != onnx::TensorProto_DataType_INT64 )
+		return false;
+
+	unsigned a = n->axis >= 0 ? n->axis : data->rank()+n->axis;
+	int64_t axis_size = data->data_dim[a];
+	size_t outer = 1;
+	size_t inner = data->data_elem_size();
+	for( unsigned d=0; d<a; d++ )
+		outer *= data->data_dim[d];
+	for( unsigned d=a+1; d<data->rank(); d++ )
+		inner *= data->data_dim[d];
+
+	const char *in = static_cast<const char*>(data->data_buffer);
+	for( size_t o=0; o<outer; o++ ) {
+		for( int i=0; i<indices->data_num_elem(); i++ ) {
+			int64_t idx = indices->get_data_element(i);
+			if( idx < 0 )
+				idx += axis_size;
+			if( idx < 0 || idx >= axis_size )
+				ERROR("Gather index out of range in node " << n->onnx_name);
+			memcpy(out, in + (o*axis_size + idx)*inner, inner);
+			out += inner;
+		}
+	}
+	return true;
+}
+
+static bool evaluate_concat(const Concat *n, char *out)
+{
+	// resolve() has made the axis non-negative
+	const Tensor *output = n->get_output_tensor(0);
+	size_t outer = 1;
+	for( int d=0; d<n->axis; d++ )
+		outer *= output->data_dim[d];
+
+	for( size_t o=0; o<outer; o++ ) {
+		for( unsigned i=0; i<n->get_number_of_inputs(); i++ ) {
+			const Tensor *input = n->get_input_tensor(i);
+			size_t chunk = input->data_num_elem() / outer * input->data_elem_size();
+			memcpy(out, static_cast<const char*>(input->data_buffer) + o*chunk, chunk);
+			out += chunk;
+		}
+	}
+	return true;
+}
+
+template <typename T>
+static void evaluate_range_as(const Range *n, void *out)
+{
+	T start = static_cast<T*>(n->get_input_tensor(0)->data_buffer)[0];
+	T delta = static_cast<T*>(n->get_input_tensor(2)->data_buffer)[0];
+	// Same arithmetic as in the generated code
+	for( int i=0; i<(int)n->output_size; i++ )
+		static_cast<T*>(out)[i] = start + (i * delta);
+}
+
+static bool evaluate_range(const Range *n, void *out)
+{
+	switch( n->get_input_tensor(0)->data_type ) {
+		case onnx::TensorProto_DataType_FLOAT:
+			evaluate_range_as<float>(n, out); return true;
+		case onnx::TensorProto_DataType_DOUBLE:
+			evaluate_range_as<double>(n, out); return true;
+		case onnx::TensorProto_DataType_INT32:
+			evaluate_range_as<int32_t>(n, out); return true;
+		default:
+			return false;
+	}
+}
+
+static bool evaluate_constantofshape(const ConstantOfShape *n, char *out)
+{
+	const Tensor *output = n->get_output_tensor(0);
+	size_t elem = output->data_elem_size();
+	for( int i=0; i<output->data_num_elem(); i++ ) {
+		// without a 'value', the output is float zeros
+		if( n->value == nullptr )
+			memset(out + i*elem, 0, elem);
+		else
+			memcpy(out + i*elem, n->value->data_buffer, elem);
+	}
+	return true;
+}
+
+template <typename From, typename To>
+static void convert(const void *in, void *out, int num_elem)
+{
+	for( int i=0; i<num_elem; i++ )
+		static_cast<To*>(out)[i] = (To)static_cast<const From*>(in)[i];
+}
+
+template <typename To>
+static bool evaluate_cast_to(const Tensor *input, void *out)
+{
+	const void *in = input->data_buffer;
+	int n = input->data_num_elem();
+	switch( input->data_type ) {
+		case onnx::TensorProto_DataType_FLOAT:  convert<float, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_DOUBLE: convert<double, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_INT8:   convert<int8_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_UINT8:  convert<uint8_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_BOOL:   convert<uint8_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_INT16:  convert<int16_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_UINT16: convert<uint16_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_INT32:  convert<int32_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_UINT32: convert<uint32_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_INT64:  convert<int64_t, To>(in, out, n); return true;
+		case onnx::TensorProto_DataType_UINT64: convert<uint64_t, To>(in, out, n); return true;
+		default:
+			return false;
+	}
+}
+
+static bool evaluate_cast(const Node *n, void *out)
+{
+	const Tensor *input = n->get_input_tensor(0);
+	switch( n->get_output_tensor(0)->data_type ) {
+		case onnx::TensorProto_DataType_FLOAT:
+			return evaluate_cast_to<float>(input, out);
+		case onnx::TensorProto_DataType_DOUBLE:
+			return evaluate_cast_to<double>(input, out);
+		default:
+			return false;
+	}
+}
+
+static bool evaluate_expand(const Node *n, char *out)
+{
+	const Tensor *input = n->get_input_tensor(0);
+	const Tensor *output = n->get_output_tensor(0);
+	unsigned rank = output->rank();
+	size_t elem = input->data_elem_size();
+
+	// Input dimensions aligned to the right of the output's, and the
+	// distance between elements in each. Broadcasted dimensions don't move.
+	std::vector<int> in_dim(rank, 1);
+	for( unsigned d=0; d<input->rank(); d++ )
+		in_dim[rank - input->rank() + d] = input->data_dim[d];
+	std::vector<size_t> in_pitch(rank);
+	size_t pitch = elem;
+	for( int d=rank-1; d>=0; d-- ) {
+		in_pitch[d] = in_dim[d] == 1 ? 0 : pitch;
+		pitch *= in_dim[d];
+	}
+
+	const char *in = static_cast<const char*>(input->data_buffer);
+	std::vector<int> idx(rank, 0);
+	for( int i=0; i<output->data_num_elem(); i++ ) {
+		size_t offset = 0;
+		for( unsigned d=0; d<rank; d++ )
+			offset += idx[d] * in_pitch[d];
+		memcpy(out, in + offset, elem);
+		out += elem;
+
+		for( int d=rank-1; d>=0; d-- ) {
+			if( ++idx[d] < output->data_dim[d] )
+				break;
+			idx[d] = 0;
+		}
+	}
+	return true;
+}
+
+bool Graph::fold_constant_node(Node *n)
+{
+	const std::string &op = n->op_name;
+	// Shape and Constant compute their output already in resolve()
+	bool output_known = op == "Shape" || op == "Constant";
+	if( output_known == false
+	 && is_reshaping_op(op) == false
+	 && op != "Gather"
+	 && op != "Concat"
+	 && op != "Range"
+	 && op != "ConstantOfShape"
+	 && op != "Cast"
+	 && op != "Expand" )
+		return false;
+
+	if( n->get_number_of_outputs() != 1 )
+		return false;
+	for( unsigned i=0; i<n->get_number_of_inputs(); i++ ) {
+		const Tensor *t = n->get_input_tensor(i);
+		if( output_known == false && t->is_used() && is_compile_time_constant(t) == false )
+			return false;
+	}
+
+	Tensor *output = n->get_output_tensor(0);
+	if( output->is_used() == false || findTensor(output->name) != output )
+		return false;
+	// The user passes in a buffer for graph outputs, and
+	// the node's function is what fills it.
+	for( const auto &o : model.graph().output() )
+		if( o.name() == output->name )
+			return false;
+
+	if( output->data_buffer == nullptr ) {
+		size_t size = (size_t)output->data_num_elem() * output->data_elem_size();
+		char *buffer = static_cast<char*>(malloc(size));
+		if( buffer == nullptr )
+			ERROR("memory allocation failed for tensor " << output->name);
+
+		bool evaluated = false;
+		if( is_reshaping_op(op) ) {
+			memcpy(buffer, n->get_input_tensor(0)->data_buffer, size);
+			evaluated = true;
+		}
+		else if( op == "Gather" )
+			evaluated = evaluate_gather(static_cast<Gather*>(n), buffer);
+		else if( op == "Concat" )
+			evaluated = evaluate_concat(static_cast<Concat*>(n), buffer);
+		else if( op == "Range" )
+			evaluated = evaluate_range(static_cast<Range*>(n), buffer);
+		else if( op == "ConstantOfShape" )
+			evaluated = evaluate_constantofshape(static_cast<ConstantOfShape*>(n), buffer);
+		else if( op == "Cast" )
+			evaluated = evaluate_cast(n, buffer);
+		else if( op == "Expand" )
+			evaluated = evaluate_expand(n, buffer);
+
+		if( evaluated == false ) {
+			free(buffer);
+			return false;
+		}
+		output->data_buffer = buffer;
+	}
+
+	LOG(DEBUG) << "Folded " << op << " node " << n->onnx_name << " into constant tensor " << output->name << std::endl;
+	output->isConst = true;
+	output->initialize = true;
+	output->generate = true;
+
+	// The node does not run, so it does not consume its inputs
+	for( unsigned i=0; i<n->get_number_of_inputs(); i++ ) {
+		Tensor *t = n->get_input_tensor(i);
+		auto &c = t->consumers;
+		c.erase(std::remove(c.begin(), c.end(), n), c.end());
+		folded_node_inputs.push_back(t);
+	}
+	num_folded_nodes++;
+	return true;
+}
+
+void Graph::remove_unused_folded_inputs(void)
+{
+	// Constants that only folded nodes used are not needed in the generated code
+	unsigned num_removed = 0;
+	for( auto t : folded_node_inputs ) {
+		if( t->consumers.size() > 0 || t->isIO || t->generate == false )
+			continue;
+		if( t->isConst == false || t->initialize == false )
+			continue;
+		LOG(TRACE) << "\tnot generating unused constant " << t->name << std::endl;
+		t->generate = false;
+		num_removed++;
+	}
+	LOG(INFO) << "Folded " << num_folded_nodes << " nodes into constants, "
+	          << num_removed << " constants became unused" << std::endl;
+	folded_node_inputs.clear();
+}
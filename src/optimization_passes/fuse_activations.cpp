@@ -0,0 +1,126 @@
+/* This file is part of onnx2c.
+ *
+ * Fuse activations optimization pass.
+ * An activation function after a Conv, ConvInteger, Gemm or MatMul
+ * is a separate loop over the whole output tensor, which reads back
+ * everything the previous node just wrote. Instead, have the previous
+ * node apply the activation to each output value as it gets calculated.
+ * The activation node, and the tensor between the two nodes, are removed.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include "nodes/clip.h"
+#include "nodes/conv.h"
+#include "nodes/convinteger.h"
+#include "nodes/elementwise.h"
+#include "nodes/gemm.h"
+#include "nodes/matmul.h"
+
+using namespace toC;
+
+static bool is_float_constant(const Tensor *t)
+{
+	return t->isConst
+	    && t->isIO == false
+	    && t->data_buffer != nullptr
+	    && t->data_type == onnx::TensorProto_DataType_FLOAT
+	    && t->data_num_elem() == 1;
+}
+
+/* Fill in 'act' to do what node 'n' does, if 'n' is one of the
+ * activations that can be fused. */
+static bool get_activation(const Node *n, FusedActivation &act)
+{
+	const std::string &op = n->op_name;
+	act.op_name = op;
+	if( op == "Relu" )
+		return true;
+	if( op == "LeakyRelu" || op == "Sigmoid" || op == "HardSwish" ) {
+		const Elementwise *e = static_cast<const Elementwise*>(n);
+		act.alpha = e->alpha;
+		act.beta = e->beta;
+		return true;
+	}
+	if( op == "Clip" ) {
+		// The limits must be known at compile time
+		const Clip *c = static_cast<const Clip*>(n);
+		act.min = c->min_attr;
+		act.max = c->max_attr;
+		for( unsigned i=1; i<n->get_number_of_inputs() && i<3; i++ ) {
+			const Tensor *t = n->get_input_tensor(i);
+			if( t->is_used() == false )
+				continue;
+			if( is_float_constant(t) == false )
+				return false;
+			if( i == 1 )
+				act.min = t->get_data_element_float(0);
+			else
+				act.max = t->get_data_element_float(0);
+		}
+		return true;
+	}
+	return false;
+}
+
+static FusedActivation* get_fused_activation(Node *n)
+{
+	const std::string &op = n->op_name;
+	if( op == "Conv" )
+		return &static_cast<Conv*>(n)->activation;
+	if( op == "ConvInteger" )
+		return &static_cast<ConvInteger*>(n)->activation;
+	if( op == "Gemm" )
+		return &static_cast<Gemm*>(n)->activation;
+	if( op == "MatMul" )
+		return &static_cast<MatMul*>(n)->activation;
+	return nullptr;
+}
+
+void Graph::fuse_activations(void)
+{
+	LOG(INFO) << "Running Fuse activations optimization pass" << std::endl;
+	PassTimer timer("fuse activations");
+
+	// Which node calculates each tensor
+	std::unordered_map<const Tensor*, Node*> producer;
+	for( auto n : nodes )
+		n->forEachOutput([&producer, n](Tensor *t) { producer[t] = n; });
+
+	unsigned num_fused = 0;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		Node *a = nodes[i];
+		FusedActivation act;
+		if( get_activation(a, act) == false )
+			continue;
+		if( a->get_number_of_outputs() != 1 )
+			continue;
+
+		// The fused-away tensor must be only for this activation
+		Tensor *x = a->get_input_tensor(0);
+		auto prod = producer.find(x);
+		if( prod == producer.end() || prod->second->get_number_of_outputs() != 1 )
+			continue;
+		if( x->isIO || x->consumers.size() != 1 )
+			continue;
+		Node *prev = prod->second;
+		FusedActivation *prev_act = get_fused_activation(prev);
+		if( prev_act == nullptr || prev_act->is_set() )
+			continue;
+		// The floating point functions don't make sense on integers
+		if( a->typeConstraint_allFloatingPoints(x) == false && act.op_name != "Relu" && act.op_name != "Clip" )
+			continue;
+
+		LOG(DEBUG) << "\tfused " << a->op_name << " " << a->onnx_name << " into " << prev->op_name << " " << prev->onnx_name << std::endl;
+		*prev_act = act;
+		Tensor *y = a->get_output_tensor(0);
+		merge_into_producer(a, prev);
+		producer[y] = prev;
+		i--;
+		num_fused++;
+	}
+
+	LOG(INFO) << "Fused " << num_fused << " activation nodes" << std::endl;
+	timer.set_items(num_fused);
+}
@@ -0,0 +1,128 @@
+/* This file is part of onnx2c.
+ *
+ * Fuse elementwise optimization pass.
+ * Each elementwise node (Add, Mul, Sigmoid, Max,...) is a loop over
+ * its whole output. A chain of them, like Mul->Add->Sigmoid->Mul,
+ * makes a pass over memory for each node, and needs a tensor for
+ * each intermediate result.
+ * Group together elementwise nodes where the output of one is used
+ * only by the others in the group, and replace the group with a
+ * FusedElementwise node that calculates all of them in one loop.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+
+#include "nodes/fused_elementwise.h"
+
+using namespace toC;
+
+void Graph::fuse_elementwise(void)
+{
+	LOG(INFO) << "Running Fuse elementwise optimization pass" << std::endl;
+	PassTimer timer("fuse elementwise");
+
+	// Which node calculates each tensor, and the order of the nodes
+	std::unordered_map<const Tensor*, Node*> producer;
+	std::unordered_map<const Node*, unsigned> position;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		Node *n = nodes[i];
+		n->forEachOutput([&producer, n](Tensor *t) { producer[t] = n; });
+		position[n] = i;
+	}
+
+	// The groups, by the last node of the group. And the
+	// group each fusable node is in.
+	std::unordered_map<Node*, std::vector<Node*>> groups;
+	std::unordered_map<const Node*, Node*> group_of;
+	for( auto n : nodes ) {
+		if( FusedElementwise::can_fuse(n) == false || n->get_number_of_outputs() != 1 )
+			continue;
+		const Tensor *y = n->get_output_tensor(0);
+		std::vector<Node*> members = {n};
+		group_of[n] = n;
+
+		// Pull in the groups that calculate this group's inputs,
+		// as long as nothing outside this group needs their output.
+		bool changed = true;
+		while( changed ) {
+			changed = false;
+			for( unsigned m=0; m<members.size(); m++ ) {
+				for( unsigned i=0; i<members[m]->get_number_of_inputs(); i++ ) {
+					Tensor *t = members[m]->get_input_tensor(i);
+					auto p = producer.find(t);
+					if( t->is_used() == false || p == producer.end() )
+						continue;
+					auto g = group_of.find(p->second);
+					if( g == group_of.end() || g->second == n || g->second != p->second )
+						continue;
+					// Intermediate values are indexed with the loop over the output
+					if( t->isIO || t->data_dim != y->data_dim )
+						continue;
+					bool used_outside = false;
+					for( auto c : t->consumers ) {
+						auto cg = group_of.find(c);
+						used_outside |= cg == group_of.end() || cg->second != n;
+					}
+					if( used_outside )
+						continue;
+
+					for( auto a : groups[p->second] ) {
+						group_of[a] = n;
+						members.push_back(a);
+					}
+					groups.erase(p->second);
+					changed = true;
+				}
+			}
+		}
+		groups[n] = members;
+	}
+
+	// Replace each group of several nodes with a FusedElementwise
+	// node, at the place of the last node of the group.
+	unsigned num_fused = 0;
+	std::vector<Node*> new_nodes;
+	for( auto n : nodes ) {
+		auto g = group_of.find(n);
+		if( g == group_of.end() || groups[g->second].size() < 2 ) {
+			new_nodes.push_back(n);
+			continue;
+		}
+		if( g->second != n )
+			continue;
+
+		std::vector<Node*> &members = groups[n];
+		std::sort(members.begin(), members.end(),
+			[&position](const Node *a, const Node *b) { return position[a] < position[b]; });
+		FusedElementwise *f = new FusedElementwise(members);
+		LOG(DEBUG) << "\tfused " << members.size() << " elementwise nodes into " << f->onnx_name << std::endl;
+
+		for( unsigned i=0; i<f->get_number_of_inputs(); i++ ) {
+			auto &c = f->get_input_tensor(i)->consumers;
+			c.erase(std::remove_if(c.begin(), c.end(),
+				[&members](const Node *m) { return std::find(members.begin(), members.end(), m) != members.end(); }),
+				c.end());
+			c.push_back(f);
+		}
+		for( auto m : members ) {
+			if( findNodeByName(m->onnx_name) == m )
+				node_index.erase(m->onnx_name);
+			if( m == n )
+				continue;
+			Tensor *t = m->get_output_tensor(0);
+			tensors.erase(std::find(tensors.begin(), tensors.end(), t));
+			if( findTensor(t->name) == t )
+				tensor_index.erase(t->name);
+		}
+		new_nodes.push_back(f);
+		indexNode(f);
+		num_fused += members.size();
+	}
+	nodes = new_nodes;
+
+	LOG(INFO) << "Fused " << num_fused << " elementwise nodes" << std::endl;
+	timer.set_items(num_fused);
+}
@@ -0,0 +1,130 @@
+/* This file is part of onnx2c.
+ *
+ * im2col convolutions optimization pass.
+ * The direct Conv loops calculate one output at a time, reading the
+ * kernel window of every input channel for it. With many channels,
+ * nothing read stays in the cache for long.
+ * Instead, the input patches of a tile of outputs can be copied into
+ * a scratch buffer as the columns of a [C*KH*KW][tile] matrix
+ * ("im2col"), and the outputs calculated as a matrix multiplication
+ * of the weights with it, a block of output channels and outputs at
+ * a time.
+ * The pass picks the Conv nodes where that pays off, pre-packs their
+ * weights for the matrix multiplication if they are constant, and adds
+ * the scratch buffer as an extra output of the node. As a node output that nothing reads,
+ * the memory planners share its memory with the other tensors.
+ * The buffer is limited to options.scratch_ram bytes. The tile of
+ * outputs is made smaller to fit, and Conv nodes where even the
+ * smallest tile doesn't fit are calculated directly.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "nodes/conv.h"
+
+// Conv nodes with fewer inputs per output (C*KH*KW) are calculated directly
+#define IM2COL_MIN_K 8
+
+using namespace toC;
+
+/* The number of outputs 'c' should calculate per tile, or 0 if
+ * 'c' should be calculated directly. 'packed_w' tells if the
+ * weights can be packed. */
+static unsigned im2col_tile(const Conv *c, bool packed_w)
+{
+	const Tensor *x = c->get_X();
+	const Tensor *w = c->get_W();
+	const Tensor *y = c->get_Y();
+	if( x->rank() != 4 || c->group != 1 || x->data_type != onnx::TensorProto_DataType_FLOAT )
+		return 0;
+	// Already calculated with Winograd, or as a matrix
+	// multiplication without copying
+	if( c->winograd_m > 0 || c->is_pointwise() )
+		return 0;
+	if( w->data_type != onnx::TensorProto_DataType_FLOAT )
+		return 0;
+
+	// Too few output channels or outputs to fill a block of the
+	// matrix multiplication, or too few inputs per output:
+	// the copying isn't worth it.
+	unsigned maps = y->data_dim[1];
+	unsigned outputs = y->data_dim[2] * y->data_dim[3];
+	unsigned K = w->data_num_elem() / maps;
+	if( maps < Conv::IM2COL_MR || outputs < Conv::IM2COL_NR || K < IM2COL_MIN_K )
+		return 0;
+	// Weights that are not packed are read a block at a time
+	if( packed_w == false && maps % Conv::IM2COL_MR != 0 )
+		return 0;
+
+	// As many outputs as fit in the scratch RAM, in whole blocks
+	unsigned outputs_rounded = (outputs + Conv::IM2COL_NR - 1) / Conv::IM2COL_NR * Conv::IM2COL_NR;
+	unsigned fits = options.scratch_ram / (K * sizeof(float));
+	fits -= fits % Conv::IM2COL_NR;
+	return std::min(outputs_rounded, fits);
+}
+
+/* Reorder the weights [M][K] to [M/MR][K][MR], so each step of the
+ * matrix multiplication reads the weights of MR output channels
+ * from consecutive addresses. The missing output channels of the
+ * last block are zeros. Returns the packed weights. */
+static float* pack_weights(const Tensor *w)
+{
+	const unsigned MR = Conv::IM2COL_MR;
+	unsigned maps = w->data_dim[0];
+	unsigned K = w->data_num_elem() / maps;
+	unsigned blocks = (maps + MR - 1) / MR;
+	float *packed = (float*)calloc(blocks * K * MR, sizeof(float));
+	if( packed == nullptr )
+		ERROR("memory allocation failed for tensor " << w->name);
+	const float *orig = (const float*)w->data_buffer;
+	for( unsigned m=0; m<maps; m++ )
+		for( unsigned k=0; k<K; k++ )
+			packed[((m/MR)*K + k)*MR + m%MR] = orig[m*K + k];
+	return packed;
+}
+
+void Graph::im2col_convolutions(void)
+{
+	LOG(INFO) << "Running im2col convolutions optimization pass" << std::endl;
+	PassTimer timer("im2col convolutions");
+
+	unsigned num_lowered = 0;
+	for( auto n : nodes ) {
+		if( n->op_name != "Conv" )
+			continue;
+		Conv *c = static_cast<Conv*>(n);
+		Tensor *w = c->get_input_tensor(1);
+		bool packed_w = is_modifiable_constant(w, c);
+		unsigned tile = im2col_tile(c, packed_w);
+		if( tile < Conv::IM2COL_NR ) {
+			LOG(DEBUG) << "\t" << c->onnx_name << " is calculated directly" << std::endl;
+			continue;
+		}
+		unsigned K = w->data_num_elem() / w->data_dim[0];
+		if( packed_w ) {
+			unsigned MR = Conv::IM2COL_MR;
+			int blocks = (w->data_dim[0] + MR - 1) / MR;
+			replace_constant_data(w, pack_weights(w), { blocks, (int)K, (int)MR });
+			c->im2col_packed_w = true;
+		}
+
+		Tensor *col = new Tensor;
+		col->name = c->get_Y()->name + "_im2col";
+		col->data_dim = { (int)K, (int)tile };
+		col->data_type = onnx::TensorProto_DataType_FLOAT;
+		tensors.push_back(col);
+		indexTensor(col);
+		c->register_output(col, "col");
+		c->im2col_tile = tile;
+
+		LOG(DEBUG) << "\t" << c->onnx_name << " calculated with im2col, " << tile << " outputs at a time" << std::endl;
+		num_lowered++;
+	}
+
+	LOG(INFO) << "Calculated " << num_lowered << " Conv nodes with im2col" << std::endl;
+	timer.set_items(num_lowered);
+}
@@ -0,0 +1,100 @@
+/* This file is part of onnx2c.
+ *
+ * In-place Concat optimization pass.
+ * Concat copies each of its inputs into its part of the output.
+ * When an input is calculated by a node just for the Concat, make
+ * the input an alias of its part of the output, so that the node
+ * calculating the input writes its result directly in place, and
+ * the Concat has nothing to copy for it.
+ * Nodes write their outputs contiguously, so this is possible only
+ * when the parts are contiguous, i.e. when all dimensions before
+ * the concatenation axis are 1 (e.g. concatenating channels with
+ * batch size 1). Other inputs are copied by the Concat node.
+ * If all inputs are in place, the Concat node is removed.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+
+#include "nodes/concat.h"
+
+using namespace toC;
+
+/* Can input 'x' of Concat 'c' be calculated in place? 'x' must be
+ * calculated by some node, and not be needed by anything else. The
+ * memory of the Concat's output is in use from when the first input
+ * in place is calculated, so other consumers would only keep it
+ * reserved longer. */
+static bool can_be_in_place(const Tensor *x, const Node *c,
+                            const std::unordered_map<const Tensor*, Node*> &producer)
+{
+	return producer.find(x) != producer.end()
+	    && x->isIO == false
+	    && x->isConst == false
+	    && x->initialize == false
+	    && x->isRecursive == false
+	    && x->isAliasOf == nullptr
+	    && x->consumers.size() == 1
+	    && x->consumers[0] == c;
+}
+
+void Graph::inplace_concat(void)
+{
+	LOG(INFO) << "Running In-place concat optimization pass" << std::endl;
+	PassTimer timer("inplace concat");
+
+	// Which node calculates each tensor. Removed Concat nodes stay
+	// here, as their inputs are still calculated into the output.
+	std::unordered_map<const Tensor*, Node*> producer;
+	for( auto n : nodes )
+		n->forEachOutput([&producer, n](Tensor *t) { producer[t] = n; });
+
+	unsigned num_in_place = 0;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		if( nodes[i]->op_name != "Concat" )
+			continue;
+		Concat *c = static_cast<Concat*>(nodes[i]);
+		Tensor *y = c->get_output_tensor(0);
+		if( y->isRecursive )
+			continue;
+		int64_t outer = 1;
+		for( int d=0; d<c->axis; d++ )
+			outer *= y->data_dim[d];
+		if( outer != 1 ) {
+			LOG(DEBUG) << "\t" << c->onnx_name << " output parts are not contiguous" << std::endl;
+			continue;
+		}
+
+		unsigned num_inputs = c->get_number_of_inputs();
+		c->inputs_in_place.assign(num_inputs, false);
+		int64_t offset = 0;
+		for( unsigned j=0; j<num_inputs; j++ ) {
+			Tensor *x = c->get_input_tensor(j);
+			if( can_be_in_place(x, c, producer) ) {
+				LOG(DEBUG) << "\t" << x->cname() << " is calculated in place into " << y->cname() << std::endl;
+				x->isAliasOf = y;
+				x->alias_offset = offset;
+				c->inputs_in_place[j] = true;
+				num_in_place++;
+			}
+			offset += x->data_num_elem();
+		}
+
+		if( std::find(c->inputs_in_place.begin(), c->inputs_in_place.end(), false) != c->inputs_in_place.end() )
+			continue;
+		// Nothing left to copy
+		LOG(DEBUG) << "\tremoving " << c->onnx_name << std::endl;
+		for( unsigned j=0; j<num_inputs; j++ )
+			c->get_input_tensor(j)->consumers.clear();
+		if( findNodeByName(c->onnx_name) == c )
+			node_index.erase(c->onnx_name);
+		nodes.erase(nodes.begin() + i);
+		i--;
+		delete c;
+	}
+
+	LOG(INFO) << "Calculated " << num_in_place << " Concat inputs in place" << std::endl;
+	timer.set_items(num_in_place);
+}
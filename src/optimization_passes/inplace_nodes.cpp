@@ -0,0 +1,154 @@
+/* This file is part of onnx2c.
+ *
+ * In-place nodes optimization pass.
+ * Relu, Clip, BatchNormalization, Softmax and the elementwise nodes
+ * read each input element before writing the output element in the
+ * same position, and never read it again. When nothing else needs
+ * the input afterwards, the output can be written over the input:
+ * make the output an alias of the input, so both are in the same memory.
+ * If the output already is an alias (e.g. an in-place Concat input),
+ * or a graph output, the input's memory is made an alias of the
+ * output instead.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "nodes/batchnormalization.h"
+#include "nodes/clip.h"
+#include "nodes/elementwise.h"
+#include "nodes/elementwise_2.h"
+#include "nodes/fused_elementwise.h"
+#include "nodes/relu.h"
+#include "nodes/softmax.h"
+
+using namespace toC;
+
+// Is 'x' all of the memory it is in, and not a part of it?
+static bool is_whole_root(const Tensor *x)
+{
+	const Tensor *root = x;
+	for( ; root->isAliasOf; root = root->isAliasOf )
+		if( root->alias_offset != 0 )
+			return false;
+	return root->data_num_elem() == x->data_num_elem()
+	    && root->data_type == x->data_type;
+}
+
+static bool can_run_in_place(const Node *n)
+{
+	return dynamic_cast<const Relu*>(n)
+	    || dynamic_cast<const Clip*>(n)
+	    || dynamic_cast<const BatchNormalization*>(n)
+	    || dynamic_cast<const Softmax*>(n)
+	    || dynamic_cast<const Elementwise*>(n)
+	    || dynamic_cast<const Elementwise_2*>(n)
+	    || dynamic_cast<const FusedElementwise*>(n);
+}
+
+void Graph::inplace_nodes(void)
+{
+	LOG(INFO) << "Running In-place nodes optimization pass" << std::endl;
+	PassTimer timer("inplace nodes");
+
+	// Which node calculates each tensor, and the tensors in the
+	// memory of each root tensor (the root included)
+	std::unordered_map<const Tensor*, unsigned> producer;
+	std::unordered_map<const Tensor*, std::vector<Tensor*>> in_memory_of;
+	for( unsigned i=0; i<nodes.size(); i++ )
+		nodes[i]->forEachOutput([&producer, i](Tensor *t) { producer[t] = i; });
+	for( auto t : tensors )
+		in_memory_of[alias_root(t)].push_back(t);
+
+	// The nodes that node 'n' must run after, i.e. that calculate
+	// anything in the memory of its inputs, and their preceding
+	// nodes. The same dependencies that schedule_nodes keeps.
+	auto preceding = [this, &producer, &in_memory_of](unsigned n) {
+		std::unordered_set<unsigned> found;
+		std::vector<unsigned> todo = {n};
+		while( todo.size() > 0 ) {
+			unsigned i = todo.back();
+			todo.pop_back();
+			for( unsigned j=0; j<nodes[i]->get_number_of_inputs(); j++ ) {
+				for( auto t : in_memory_of[alias_root(nodes[i]->get_input_tensor(j))] ) {
+					auto p = producer.find(t);
+					if( p == producer.end() || p->second >= i )
+						continue;
+					if( found.insert(p->second).second )
+						todo.push_back(p->second);
+				}
+			}
+		}
+		return found;
+	};
+
+	// Can node 'n' write over input 'x'? Anything else reading
+	// the memory of 'x' must run before 'n'.
+	auto is_last_use = [this, &preceding, &in_memory_of](unsigned n, Tensor *x) {
+		Tensor *root = alias_root(x);
+		if( is_intermediate(root) == false )
+			return false;
+		std::unordered_set<unsigned> before;
+		bool before_known = false;
+		for( auto t : in_memory_of[root] ) {
+			for( auto c : t->consumers ) {
+				if( c == nodes[n] )
+					continue;
+				if( before_known == false ) {
+					before = preceding(n);
+					before_known = true;
+				}
+				auto ci = std::find(nodes.begin(), nodes.end(), c);
+				if( ci == nodes.end() || before.count(ci - nodes.begin()) == 0 )
+					return false;
+			}
+		}
+		return true;
+	};
+
+	unsigned num_in_place = 0;
+	for( unsigned i=0; i<nodes.size(); i++ ) {
+		Node *n = nodes[i];
+		if( can_run_in_place(n) == false || n->get_number_of_outputs() != 1 )
+			continue;
+		Tensor *y = n->get_output_tensor(0);
+		if( y->is_used() == false || y->isRecursive || alias_root(y)->isRecursive )
+			continue;
+
+		for( unsigned j=0; j<n->get_number_of_inputs(); j++ ) {
+			Tensor *x = n->get_input_tensor(j);
+			if( x->data_dim != y->data_dim || x->data_type != y->data_type )
+				continue;
+			if( is_last_use(i, x) == false )
+				continue;
+
+			Tensor *from, *to;
+			if( y->isAliasOf == nullptr && is_intermediate(y) ) {
+				from = y;
+				to = x;
+			}
+			else if( alias_root(x) != alias_root(y) && is_whole_root(x) ) {
+				from = alias_root(x);
+				to = y;
+			}
+			else
+				continue;
+			LOG(DEBUG) << "\t" << n->onnx_name << " writes " << y->cname() << " over " << x->cname() << std::endl;
+
+			// 'from' and the tensors in its memory move into the memory of 'to'
+			Tensor *root = alias_root(to);
+			from->isAliasOf = to;
+			std::vector<Tensor*> &moved = in_memory_of[from];
+			in_memory_of[root].insert(in_memory_of[root].end(), moved.begin(), moved.end());
+			in_memory_of.erase(from);
+			num_in_place++;
+			break;
+		}
+	}
+
+	LOG(INFO) << "Made " << num_in_place << " nodes calculate in place" << std::endl;
+	timer.set_items(num_in_place);
+}
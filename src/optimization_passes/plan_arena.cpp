@@ -0,0 +1,94 @@
+/* This file is part of onnx2c.
+ *
+ * Arena memory planner optimization pass.
+ * An alternative to unionize_tensors. A union is as large as the
+ * largest tensor ever put in it, so the unions together can take
+ * much more memory than what is in use at any one time.
+ * Instead, place all intermediate tensors into one static arena,
+ * each at a byte offset, so that tensors that are needed at the same
+ * time don't overlap. The offsets are found with the "greedy by size"
+ * heuristic: the largest tensors are placed first, each into the
+ * smallest gap between the already placed tensors whose lifetimes
+ * overlap with it.
+ * The arena can't be smaller than the most bytes that are needed
+ * at the same time. The pass reports how close it got to that.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+#include <limits>
+
+// Every tensor starts at a multiple of this many bytes
+#define ARENA_ALIGN 16
+
+using namespace toC;
+
+namespace {
+struct ArenaTensor {
+	Tensor *t;
+	uint64_t size; // aligned
+	unsigned first; // the nodes that calculate and use the tensor
+	unsigned last;
+	uint64_t offset;
+};
+}
+
+void Graph::plan_arena(void)
+{
+	LOG(INFO) << "Running Arena memory planner optimization pass" << std::endl;
+	PassTimer timer("plan arena");
+
+	// The same tensors that unionize_tensors puts into unions
+	std::vector<TensorLifetime> lifetimes = intermediate_lifetimes();
+	std::vector<ArenaTensor> planned;
+	for( auto &l : lifetimes ) {
+		uint64_t size = (uint64_t)l.t->data_num_elem() * l.t->data_elem_size();
+		size += (ARENA_ALIGN - size % ARENA_ALIGN) % ARENA_ALIGN;
+		planned.push_back({l.t, size, l.first, l.last, 0});
+	}
+	// The arena can't be smaller than this
+	uint64_t lower_bound = peak_bytes(lifetimes);
+
+	std::vector<ArenaTensor*> order;
+	for( auto &a : planned )
+		order.push_back(&a);
+	std::stable_sort(order.begin(), order.end(),
+		[](const ArenaTensor *a, const ArenaTensor *b) { return a->size > b->size; });
+
+	std::vector<ArenaTensor*> placed;
+	arena_size = 0;
+	for( auto a : order ) {
+		// The already placed tensors in use at the same time, by offset
+		std::vector<ArenaTensor*> overlapping;
+		for( auto p : placed )
+			if( p->first <= a->last && a->first <= p->last )
+				overlapping.push_back(p);
+		std::sort(overlapping.begin(), overlapping.end(),
+			[](const ArenaTensor *x, const ArenaTensor *y) { return x->offset < y->offset; });
+
+		// The smallest gap that fits, or after all of them
+		uint64_t best_offset = 0, best_gap = std::numeric_limits<uint64_t>::max();
+		uint64_t gap_start = 0;
+		bool found = false;
+		for( auto p : overlapping ) {
+			if( p->offset >= gap_start + a->size && p->offset - gap_start < best_gap ) {
+				best_offset = gap_start;
+				best_gap = p->offset - gap_start;
+				found = true;
+			}
+			gap_start = std::max(gap_start, p->offset + p->size);
+		}
+		a->offset = found ? best_offset : gap_start;
+		arena_size = std::max(arena_size, a->offset + a->size);
+		arena_offsets[a->t] = a->offset;
+		placed.push_back(a);
+		LOG(DEBUG) << "\t" << a->t->cname() << " at " << a->offset << ", " << a->size << " bytes, used by nodes " << a->first << "-" << a->last << std::endl;
+	}
+	arena_lower_bound = lower_bound;
+
+	LOG(INFO) << "Arena of " << arena_size << " bytes for " << planned.size() << " tensors, "
+	          << "at most " << lower_bound << " bytes are in use at the same time" << std::endl;
+	timer.set_items(arena_size);
+}
@@ -0,0 +1,164 @@
+/* This file is part of onnx2c.
+ *
+ * Schedule nodes optimization pass.
+ * The nodes are run in the order they got resolved in. When a graph
+ * branches (e.g. Inception blocks, U-Net skip connections), that order
+ * can calculate the start of every branch before finishing any, keeping
+ * large tensors alive at the same time for no reason.
+ * Reorder the nodes, keeping each node after the nodes calculating its
+ * inputs, so that fewer bytes of intermediate tensors are in use at
+ * the same time. This is what the memory of the unions (or the arena)
+ * needs to hold at the most.
+ * The order is chosen greedily: of the nodes that can run next, run
+ * the one after which the least memory is in use. If that order is
+ * not better than the original, the original is kept.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+
+using namespace toC;
+
+void Graph::schedule_nodes(void)
+{
+	LOG(INFO) << "Running Schedule nodes optimization pass" << std::endl;
+	PassTimer timer("schedule nodes");
+	unsigned num_nodes = nodes.size();
+
+	// Which nodes calculate each tensor. The memory of an alias is
+	// its root's memory, so e.g. an in-place Concat output is
+	// calculated by all the nodes calculating the Concat's inputs.
+	std::unordered_map<const Tensor*, std::vector<unsigned>> producers;
+	for( unsigned i=0; i<num_nodes; i++ )
+		nodes[i]->forEachOutput([&producers, i](Tensor *o) {
+			producers[alias_root(o)].push_back(i);
+		});
+
+	// The nodes each node must run after, and the intermediate
+	// tensors (roots) each node calculates or uses.
+	// The original order is valid, so only earlier nodes count.
+	std::vector<std::vector<unsigned>> preceding(num_nodes);
+	std::vector<std::vector<const Tensor*>> uses(num_nodes);
+	std::unordered_map<const Tensor*, unsigned> num_users;
+	for( unsigned i=0; i<num_nodes; i++ ) {
+		auto use = [&uses, i](const Tensor *t) {
+			if( is_intermediate(t) && std::find(uses[i].begin(), uses[i].end(), t) == uses[i].end() )
+				uses[i].push_back(t);
+		};
+		for( unsigned j=0; j<nodes[i]->get_number_of_inputs(); j++ ) {
+			Tensor *t = alias_root(nodes[i]->get_input_tensor(j));
+			use(t);
+			auto p = producers.find(t);
+			if( p == producers.end() )
+				continue;
+			for( auto q : p->second )
+				if( q < i )
+					preceding[i].push_back(q);
+		}
+		nodes[i]->forEachOutput([&use](Tensor *o) { use(alias_root(o)); });
+		for( auto t : uses[i] )
+			num_users[t]++;
+	}
+
+	auto size = [](const Tensor *t) {
+		return (uint64_t)t->data_num_elem() * t->data_elem_size();
+	};
+
+	// Simulate running the nodes, one after another. The tensors are
+	// in use from the first node using them to the last one.
+	struct State {
+		uint64_t live = 0;
+		uint64_t peak = 0;
+		std::unordered_map<const Tensor*, unsigned> users_left;
+	};
+	// The bytes in use while running node i, and after it
+	auto cost = [&uses, &size, &num_users](const State &s, unsigned i, uint64_t &during, uint64_t &after) {
+		during = s.live;
+		after = s.live;
+		for( auto t : uses[i] ) {
+			auto left = s.users_left.find(t);
+			unsigned users = left == s.users_left.end() ? num_users[t] : left->second;
+			if( users == num_users[t] )
+				during += size(t);
+			if( users == 1 )
+				after -= size(t);
+		}
+		after += during - s.live;
+	};
+	auto run = [&uses, &num_users, &cost](State &s, unsigned i) {
+		uint64_t during, after;
+		cost(s, i, during, after);
+		s.peak = std::max(s.peak, during);
+		s.live = after;
+		for( auto t : uses[i] ) {
+			auto left = s.users_left.emplace(t, num_users[t]).first;
+			left->second--;
+		}
+	};
+
+	State original;
+	for( unsigned i=0; i<num_nodes; i++ )
+		run(original, i);
+
+	std::vector<std::vector<unsigned>> following(num_nodes);
+	std::vector<unsigned> num_preceding(num_nodes, 0);
+	for( unsigned i=0; i<num_nodes; i++ ) {
+		std::sort(preceding[i].begin(), preceding[i].end());
+		preceding[i].erase(std::unique(preceding[i].begin(), preceding[i].end()), preceding[i].end());
+		num_preceding[i] = preceding[i].size();
+		for( auto q : preceding[i] )
+			following[q].push_back(i);
+	}
+
+	State greedy;
+	std::vector<unsigned> order;
+	std::vector<unsigned> ready;
+	for( unsigned i=0; i<num_nodes; i++ )
+		if( num_preceding[i] == 0 )
+			ready.push_back(i);
+	while( ready.size() > 0 ) {
+		// Least memory in use after the node, then while it runs,
+		// then the original order
+		unsigned best = 0;
+		uint64_t best_after = 0, best_during = 0;
+		for( unsigned r=0; r<ready.size(); r++ ) {
+			uint64_t during, after;
+			cost(greedy, ready[r], during, after);
+			if( r == 0
+			 || after < best_after
+			 || (after == best_after && during < best_during)
+			 || (after == best_after && during == best_during && ready[r] < ready[best]) ) {
+				best = r;
+				best_after = after;
+				best_during = during;
+			}
+		}
+		unsigned n = ready[best];
+		ready.erase(ready.begin() + best);
+		run(greedy, n);
+		order.push_back(n);
+		for( auto f : following[n] )
+			if( --num_preceding[f] == 0 )
+				ready.push_back(f);
+	}
+	if( order.size() != num_nodes )
+		ERROR("Node scheduling left out nodes. Dependency cycle?");
+
+	unsigned num_moved = 0;
+	if( greedy.peak < original.peak ) {
+		std::vector<Node*> scheduled;
+		for( unsigned i=0; i<num_nodes; i++ ) {
+			scheduled.push_back(nodes[order[i]]);
+			num_moved += order[i] != i;
+		}
+		nodes = scheduled;
+		LOG(INFO) << "Reordered " << num_moved << " nodes. At most " << greedy.peak << " bytes of intermediate tensors "
+		          << "are in use at the same time, instead of " << original.peak << std::endl;
+	}
+	else
+		LOG(INFO) << "Kept the original order of nodes. At most " << original.peak << " bytes of intermediate tensors "
+		          << "are in use at the same time" << std::endl;
+	timer.set_items(num_moved);
+}
@@ -1,5 +1,7 @@
 #include "graph.h"
+#include "pass_timer.h"
 #include <cstdint>
+#include <unordered_map>
 
 using namespace toC;
 // add t to union. Return allocated union number
@@ -39,10 +41,22 @@ void Graph::mark_union_unoccupied(uint32_t u)
 void Graph::unionize_tensors(void)
 {
 	LOG(INFO) << "Running Unionize optimization pass" << std::endl;
+	PassTimer timer("unionize tensors");
 	for( auto n : nodes ) {
 		n->isResolved = false;
 	}
 
+	// Tensors that are aliases of (views into) each tensor. The memory
+	// is in use also as long as the aliases are used.
+	std::unordered_map<const Tensor*, std::vector<const Tensor*>> aliases;
+	for( auto t : tensors ) {
+		const Tensor *orig = t;
+		while( orig->isAliasOf )
+			orig = orig->isAliasOf;
+		if( orig != t )
+			aliases[orig].push_back(t);
+	}
+
 	for( auto n : nodes ) {
 
 		LOG(TRACE) << "\tunionizing outputs of node: " << n->onnx_name << std::endl;
@@ -52,6 +66,11 @@ void Graph::unionize_tensors(void)
 			[this](Tensor *o)
 			{
 				LOG(TRACE) << "\t\tconsidering output: " << o->name << std::endl;
+				// An alias is calculated into the memory of the tensor it
+				// is an alias of (e.g. the output of an in-place Concat).
+				// That memory is needed from when the first alias is calculated.
+				while( o->isAliasOf )
+					o = o->isAliasOf;
 				LOG(TRACE) << "\t\t\t" << o->print_trace_dump() << std::endl;
 				// assign tensor to next free union
 				// if it is an internal tensor that gets
@@ -87,11 +106,15 @@ void Graph::unionize_tensors(void)
 			bool all_resolved = true;
 			for( auto c : t->consumers )
 				all_resolved &= c->isResolved;
+			for( auto a : aliases[t] )
+				for( auto c : a->consumers )
+					all_resolved &= c->isResolved;
 			if (all_resolved)
 				mark_union_unoccupied(ui);
 		}
 	}
 
 	LOG(TRACE) << "Unionize optimization pass finished" << std::endl;
+	timer.set_items(tensor_unions.size());
 }
 
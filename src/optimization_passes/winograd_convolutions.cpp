@@ -0,0 +1,141 @@
+/* This file is part of onnx2c.
+ *
+ * Winograd convolutions optimization pass.
+ * A 3x3 convolution with stride 1 can be calculated in tiles of m x m
+ * outputs with the Winograd transform F(mxm,3x3) (see nodes/winograd.h):
+ * with (m+2)^2 multiplications per tile and input channel, instead
+ * of 9*m*m. That is 16 instead of 36 for F(2x2,3x3), and 36 instead
+ * of 144 for F(4x4,3x3). The larger tiles lose more precision, and
+ * waste more calculations on the edges of small outputs.
+ * The transform of the weights is calculated at compile time, when
+ * the weights are constant. This makes them (m+2)^2/9 times larger.
+ * Otherwise the weights get transformed in each call, into a scratch
+ * buffer.
+ * The transformed input and the products for a number of tiles at a
+ * time are also scratch buffers. The scratch buffers are extra outputs
+ * of the node that nothing reads, so the memory planners share their
+ * memory with the other tensors. Together, they are limited to
+ * options.scratch_ram bytes.
+ */
+#include "graph.h"
+#include "options.h"
+#include "pass_timer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "nodes/conv.h"
+
+// Conv nodes with fewer input or output channels are calculated
+// directly: the transforms would take more time than they save
+#define WINOGRAD_MIN_CHANNELS 4
+// F(4x4,3x3) is used when the output is at least this large in both dimensions
+#define WINOGRAD_F4_MIN_SIZE 8
+
+using namespace toC;
+
+static bool can_use_winograd(const Conv *c)
+{
+	const Tensor *x = c->get_X();
+	const Tensor *w = c->get_W();
+	if( x->rank() != 4 || c->group != 1
+	 || x->data_type != onnx::TensorProto_DataType_FLOAT
+	 || w->data_type != onnx::TensorProto_DataType_FLOAT )
+		return false;
+	for( unsigned i=0; i<2; i++ )
+		if( c->kernel_shape[i] != 3 || c->strides[i] != 1 || c->dilations[i] != 1 )
+			return false;
+	return x->data_dim[1] >= WINOGRAD_MIN_CHANNELS
+	    && c->get_Y()->data_dim[1] >= WINOGRAD_MIN_CHANNELS;
+}
+
+/* How many tiles of F(mxm,3x3) fit in the scratch RAM at a time,
+ * 0 if not even one. */
+static unsigned winograd_tiles(const Conv *c, unsigned m, bool const_w)
+{
+	uint64_t n2 = (m+2) * (m+2);
+	uint64_t channels = c->get_X()->data_dim[1];
+	uint64_t maps = c->get_Y()->data_dim[1];
+	uint64_t out_h = c->get_Y()->data_dim[2];
+	uint64_t out_w = c->get_Y()->data_dim[3];
+	uint64_t tiles = ((out_h + m - 1) / m) * ((out_w + m - 1) / m);
+
+	uint64_t fixed = const_w ? 0 : n2 * maps * channels * sizeof(float);
+	uint64_t per_tile = n2 * (channels + maps) * sizeof(float);
+	if( options.scratch_ram < fixed + per_tile )
+		return 0;
+	return std::min(tiles, (options.scratch_ram - fixed) / per_tile);
+}
+
+static Tensor* scratch_tensor(const std::string &name, const std::vector<int> &dims)
+{
+	Tensor *t = new Tensor;
+	t->name = name;
+	t->data_dim = dims;
+	t->data_type = onnx::TensorProto_DataType_FLOAT;
+	return t;
+}
+
+void Graph::winograd_convolutions(void)
+{
+	LOG(INFO) << "Running Winograd convolutions optimization pass" << std::endl;
+	PassTimer timer("winograd convolutions");
+
+	unsigned num_lowered = 0;
+	for( auto n : nodes ) {
+		if( n->op_name != "Conv" )
+			continue;
+		Conv *c = static_cast<Conv*>(n);
+		if( can_use_winograd(c) == false ) {
+			LOG(DEBUG) << "\t" << c->onnx_name << " is not a 3x3 convolution with stride 1" << std::endl;
+			continue;
+		}
+		Tensor *w = c->get_input_tensor(1);
+		bool const_w = is_modifiable_constant(w, c);
+
+		unsigned m = 0, tiles = 0;
+		const Tensor *y = c->get_Y();
+		if( y->data_dim[2] >= WINOGRAD_F4_MIN_SIZE && y->data_dim[3] >= WINOGRAD_F4_MIN_SIZE )
+			tiles = winograd_tiles(c, m = 4, const_w);
+		if( tiles == 0 )
+			tiles = winograd_tiles(c, m = 2, const_w);
+		if( tiles == 0 ) {
+			LOG(DEBUG) << "\t" << c->onnx_name << " needs more scratch RAM for Winograd" << std::endl;
+			continue;
+		}
+
+		const WinogradTransform &wt = WinogradTransform::get(m);
+		int n2 = wt.n * wt.n;
+		int channels = c->get_X()->data_dim[1];
+		int maps = y->data_dim[1];
+		if( const_w ) {
+			float *u = (float*)calloc(n2 * maps * channels, sizeof(float));
+			if( u == nullptr )
+				ERROR("memory allocation failed for tensor " << w->name);
+			wt.transform_weights((const float*)w->data_buffer, u, maps, channels);
+			replace_constant_data(w, u, { n2, maps, channels });
+		}
+
+		std::vector<Tensor*> scratch;
+		scratch.push_back(scratch_tensor(y->name + "_winograd_v", { n2, channels, (int)tiles }));
+		scratch.push_back(scratch_tensor(y->name + "_winograd_mt", { n2, maps, (int)tiles }));
+		if( const_w == false )
+			scratch.push_back(scratch_tensor(y->name + "_winograd_u", { n2, maps, channels }));
+		const char *names[] = { "v", "mt", "u" };
+		for( unsigned i=0; i<scratch.size(); i++ ) {
+			tensors.push_back(scratch[i]);
+			indexTensor(scratch[i]);
+			c->register_output(scratch[i], names[i]);
+		}
+		c->winograd_m = m;
+		c->winograd_tiles = tiles;
+		c->winograd_const_w = const_w;
+
+		LOG(DEBUG) << "\t" << c->onnx_name << " calculated with F(" << m << "x" << m << ",3x3), "
+		           << tiles << " tiles at a time" << std::endl;
+		num_lowered++;
+	}
+
+	LOG(INFO) << "Calculated " << num_lowered << " Conv nodes with Winograd" << std::endl;
+	timer.set_items(num_lowered);
+}
@@ -6,7 +6,9 @@
 #include "error.h"
 #include "timestamp.h"
 
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
 struct onnx2c_opts options;
 
@@ -68,6 +70,18 @@ void print_optimization_passes(void)
 {
 	std::cout << "Available optimization passes:" << std::endl;
 	std::cout << " - 'unionize' (defaut:on)" << std::endl;
+	std::cout << " - 'dedupe' (defaut:on)" << std::endl;
+	std::cout << " - 'fold' (defaut:on)" << std::endl;
+	std::cout << " - 'fold_bn' (defaut:on)" << std::endl;
+	std::cout << " - 'fuse' (defaut:on)" << std::endl;
+	std::cout << " - 'fuse_ew' (defaut:on)" << std::endl;
+	std::cout << " - 'alias' (defaut:on)" << std::endl;
+	std::cout << " - 'concat' (defaut:on)" << std::endl;
+	std::cout << " - 'inplace' (defaut:on)" << std::endl;
+	std::cout << " - 'schedule' (defaut:on)" << std::endl;
+	std::cout << " - 'arena' (defaut:off, replaces 'unionize')" << std::endl;
+	std::cout << " - 'im2col' (defaut:off)" << std::endl;
+	std::cout << " - 'winograd' (defaut:off)" << std::endl;
 	std::cout << " - 'none' (disable all optimization passes)" << std::endl;
 }
 
@@ -78,6 +92,18 @@ void store_optimization_passes(const std::string &opt)
 	// disable all optimizations (i.e. override the default settings)
 	// then enable those that were requested
 	options.opt_unionize=false;
+	options.opt_dedupe=false;
+	options.opt_fold_constants=false;
+	options.opt_fold_batchnorm=false;
+	options.opt_fuse_activations=false;
+	options.opt_fuse_elementwise=false;
+	options.opt_alias_views=false;
+	options.opt_inplace_concat=false;
+	options.opt_inplace_nodes=false;
+	options.opt_schedule=false;
+	options.opt_arena=false;
+	options.opt_im2col=false;
+	options.opt_winograd=false;
 	if( opt == "none" )
 	{
 		LOG(TRACE) << "Disabling all optimizations: " << opt << std::endl;
@@ -98,6 +124,66 @@ void store_optimization_passes(const std::string &opt)
 			LOG(DEBUG) << "Enabling 'Unionize tensors' optimization pass" << std::endl;
 			options.opt_unionize=true;
 		}
+		else if( item == "dedupe" )
+		{
+			LOG(DEBUG) << "Enabling 'Dedupe tensors' optimization pass" << std::endl;
+			options.opt_dedupe=true;
+		}
+		else if( item == "fold" )
+		{
+			LOG(DEBUG) << "Enabling 'Fold constants' optimization pass" << std::endl;
+			options.opt_fold_constants=true;
+		}
+		else if( item == "fold_bn" )
+		{
+			LOG(DEBUG) << "Enabling 'Fold BatchNormalization' optimization pass" << std::endl;
+			options.opt_fold_batchnorm=true;
+		}
+		else if( item == "fuse" )
+		{
+			LOG(DEBUG) << "Enabling 'Fuse activations' optimization pass" << std::endl;
+			options.opt_fuse_activations=true;
+		}
+		else if( item == "fuse_ew" )
+		{
+			LOG(DEBUG) << "Enabling 'Fuse elementwise' optimization pass" << std::endl;
+			options.opt_fuse_elementwise=true;
+		}
+		else if( item == "alias" )
+		{
+			LOG(DEBUG) << "Enabling 'Alias views' optimization pass" << std::endl;
+			options.opt_alias_views=true;
+		}
+		else if( item == "concat" )
+		{
+			LOG(DEBUG) << "Enabling 'In-place concat' optimization pass" << std::endl;
+			options.opt_inplace_concat=true;
+		}
+		else if( item == "inplace" )
+		{
+			LOG(DEBUG) << "Enabling 'In-place nodes' optimization pass" << std::endl;
+			options.opt_inplace_nodes=true;
+		}
+		else if( item == "schedule" )
+		{
+			LOG(DEBUG) << "Enabling 'Schedule nodes' optimization pass" << std::endl;
+			options.opt_schedule=true;
+		}
+		else if( item == "arena" )
+		{
+			LOG(DEBUG) << "Enabling 'Arena memory planner' optimization pass" << std::endl;
+			options.opt_arena=true;
+		}
+		else if( item == "im2col" )
+		{
+			LOG(DEBUG) << "Enabling 'im2col convolutions' optimization pass" << std::endl;
+			options.opt_im2col=true;
+		}
+		else if( item == "winograd" )
+		{
+			LOG(DEBUG) << "Enabling 'Winograd convolutions' optimization pass" << std::endl;
+			options.opt_winograd=true;
+		}
 		else {
 			LOG(WARNING) << "Optimization pass " << item << " does not exist" << std::endl;
 		}
@@ -113,8 +199,16 @@ void parse_cmdline_options(int argc, const char *argv[])
 	args::ValueFlag<int> loglevel(parser, "level", "Logging verbosity. 0(none)-4(all)", {'l',"log"});
 	args::ValueFlag<std::string> optimizations(parser, "opt[,opt]...", "Specify optimization passes to run. ('help' to list available)", {'p', "optimizations"});
 	args::Flag help(parser, "help", "Print this help text.", {'h',"help"});
+	args::ValueFlag<unsigned> jobs(parser, "N", "Number of threads to generate the C source with. 0 for one per CPU core. The output is the same for any N. (default: 1)", {'j', "jobs"});
 	args::Flag quantize(parser, "quantize", "Quantize network (EXPERIMENTAL!)", {'q', "quantize"});
+	args::Flag time_passes(parser, "time-passes", "Print the time and memory each compilation phase takes on stderr", {"time-passes"});
+	args::ValueFlag<std::string> trace(parser, "file", "Write the time and memory each compilation phase takes into a Chrome trace event JSON file", {"trace"});
+	args::ValueFlag<unsigned> scratch_ram(parser, "bytes", "Most bytes of scratch memory a node may use, for the 'im2col' and 'winograd' optimization passes. (default: 65536)", {"scratch-ram"});
+	args::ValueFlag<std::string> report(parser, "format", "Print a report of the memory the generated code needs and the calculations it does, instead of the C source. Format: 'json'", {"report"});
+	args::Flag node_hooks(parser, "node-hooks", "Wrap each node call in the generated entry() in ONNX2C_NODE_BEGIN(id, name) and ONNX2C_NODE_END(id) macros, e.g. for timing the nodes. Compile with -DONNX2C_PROFILE for a default profiler", {"node-hooks"});
 	args::Flag version(parser, "version", "Print onnx2c version", {'v', "version"});
+	args::ValueFlag<std::string> weights_blob(parser, "file", "Write constant tensors into a binary file, which the generated source includes with .incbin. Give the path as the C compiler should see it. (GCC/Clang, ELF targets)", {"weights-blob"});
+	args::ValueFlag<std::string> weights_file(parser, "file", "Write constant tensors into a weights file, to be loaded at run time with the generated entry_init() function", {"weights-file"});
 	args::Positional<std::string> input(parser, "input", "ONNX file to process");
 	try
 	{
@@ -145,6 +239,22 @@ void parse_cmdline_options(int argc, const char *argv[])
 	initialize_logging();
 
 	if (quantize) { options.quantize = true; }
+	if (time_passes) { options.time_passes = true; }
+	if (trace) { options.trace_file = args::get(trace); }
+	if (node_hooks) { options.node_hooks = true; }
+	if (scratch_ram) { options.scratch_ram = args::get(scratch_ram); }
+	if (report) {
+		options.report = args::get(report);
+		if( options.report != "json" ) {
+			std::cerr << "Unknown report format '" << options.report << "'";
+			hint_at_help_and_exit();
+		}
+	}
+	if (jobs) {
+		options.jobs = args::get(jobs);
+		if( options.jobs == 0 )
+			options.jobs = std::max(1u, std::thread::hardware_concurrency());
+	}
 	if (avr) { options.target_avr = true; }
 	if (define) {
 		for (const auto &d: args::get(define)) {
@@ -152,6 +262,16 @@ void parse_cmdline_options(int argc, const char *argv[])
 		}
 	}
 	if (optimizations) { store_optimization_passes( args::get(optimizations) ); }
+	if (weights_blob) { options.weights_blob = args::get(weights_blob); }
+	if (weights_file) { options.weights_file = args::get(weights_file); }
+	if (options.weights_blob != "" && options.weights_file != "") {
+		std::cerr << "Give only one of --weights-blob and --weights-file";
+		hint_at_help_and_exit();
+	}
+	if (options.target_avr && (options.weights_blob != "" || options.weights_file != "")) {
+		std::cerr << "Binary weights can't be used when targeting AVR";
+		hint_at_help_and_exit();
+	}
 	if (input) { options.input_file = args::get(input); }
 	if (options.input_file == "" ) { std::cerr << "No input file given"; hint_at_help_and_exit(); }
 }
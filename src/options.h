@@ -12,6 +12,18 @@ struct onnx2c_opts
 	bool quantize=false;
 	bool target_avr=false;
 	bool opt_unionize=true;
+	bool opt_dedupe=true;
+	bool opt_fold_constants=true;
+	bool opt_fold_batchnorm=true;
+	bool opt_fuse_activations=true;
+	bool opt_fuse_elementwise=true;
+	bool opt_alias_views=true;
+	bool opt_inplace_concat=true;
+	bool opt_inplace_nodes=true;
+	bool opt_schedule=true;
+	bool opt_arena=false; // replaces opt_unionize
+	bool opt_im2col=false;
+	bool opt_winograd=false;
 	/*
 	 * logging levels are
 	 * cmd line     aixlog     Use
@@ -29,6 +41,24 @@ struct onnx2c_opts
 	int logging_level=DEFAULT_LOG_LEVEL;  // Default level set by CMake. 1 in release, 4 in debug builds
 	std::string input_file;
 	std::map<std::string, uint32_t> dim_defines;
+	// If set, write constant tensors into this binary file instead of
+	// printing them as C initializers. The generated source .incbin's the file.
+	std::string weights_blob;
+	// Same, but the file is loaded at run time with entry_init()
+	std::string weights_file;
+	// Number of threads used to print out the C source
+	unsigned jobs=1;
+	// Report time and memory used by each compilation phase
+	bool time_passes=false;
+	// and/or write them into this Chrome trace JSON file
+	std::string trace_file;
+	// Print a report of the memory and calculations in this
+	// format instead of the C source. Only "json" for now.
+	std::string report;
+	// Wrap each node call in entry() in ONNX2C_NODE_BEGIN/END macros
+	bool node_hooks=false;
+	// Most bytes of scratch memory a node may use, e.g. for im2col or Winograd
+	unsigned scratch_ram=65536;
 };
 
 extern struct onnx2c_opts options;
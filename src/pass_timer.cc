@@ -0,0 +1,121 @@
+/* This file is part of onnx2c.
+ *
+ * Instrumentation of onnx2c itself. See pass_timer.h
+ */
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "error.h"
+#include "options.h"
+#include "pass_timer.h"
+
+using namespace toC;
+
+struct TimedPass {
+	std::string name;
+	unsigned depth;        // nesting level
+	int64_t start_us;      // from the first timer started
+	int64_t duration_us;
+	int64_t peak_rss_kb;   // process peak RSS at the end of the phase
+	int64_t items;         // negative if not set
+};
+
+static std::vector<TimedPass> passes;
+static unsigned current_depth = 0;
+static const auto time_origin = std::chrono::steady_clock::now();
+
+static int64_t now_us(void)
+{
+	auto d = std::chrono::steady_clock::now() - time_origin;
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static int64_t peak_rss_kb(void)
+{
+	struct rusage ru;
+	if( getrusage(RUSAGE_SELF, &ru) != 0 )
+		return 0;
+	// macOS reports bytes, Linux kilobytes
+#ifdef __APPLE__
+	return ru.ru_maxrss / 1024;
+#else
+	return ru.ru_maxrss;
+#endif
+}
+
+PassTimer::PassTimer(const std::string &name)
+	: record(-1)
+{
+	if( options.time_passes == false && options.trace_file == "" )
+		return;
+
+	record = passes.size();
+	passes.push_back({name, current_depth, now_us(), 0, 0, -1});
+	current_depth++;
+}
+
+PassTimer::~PassTimer()
+{
+	if( record < 0 )
+		return;
+
+	TimedPass &p = passes[record];
+	p.duration_us = now_us() - p.start_us;
+	p.peak_rss_kb = peak_rss_kb();
+	current_depth--;
+	LOG(DEBUG) << "Phase '" << p.name << "' took " << p.duration_us << "us" << std::endl;
+}
+
+void PassTimer::set_items(uint64_t items)
+{
+	if( record >= 0 )
+		passes[record].items = items;
+}
+
+void toC::print_pass_times(std::ostream &dst)
+{
+	dst << "onnx2c pass timings:" << std::endl;
+	dst << std::setw(12) << "wall (ms)" << std::setw(16) << "peak RSS (MB)";
+	dst << std::setw(12) << "items" << "   phase" << std::endl;
+	for( const auto &p : passes ) {
+		dst << std::fixed << std::setprecision(3);
+		dst << std::setw(12) << p.duration_us / 1000.0;
+		dst << std::setprecision(1);
+		dst << std::setw(16) << p.peak_rss_kb / 1024.0;
+		if( p.items >= 0 )
+			dst << std::setw(12) << p.items;
+		else
+			dst << std::setw(12) << "";
+		dst << "   " << std::string(2*p.depth, ' ') << p.name << std::endl;
+	}
+	dst << std::defaultfloat;
+}
+
+void toC::write_pass_trace(const std::string &filename)
+{
+	std::ofstream trace(filename);
+	if( !trace.good() )
+		ERROR("Could not open trace file " << filename << " for writing");
+
+	// One "complete" (ph:X) event per phase. The nesting is seen from the times.
+	trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+	for( unsigned i=0; i<passes.size(); i++ ) {
+		const TimedPass &p = passes[i];
+		trace << "{\"name\":\"" << p.name << "\",\"cat\":\"onnx2c\",\"ph\":\"X\",";
+		trace << "\"pid\":1,\"tid\":1,\"ts\":" << p.start_us << ",\"dur\":" << p.duration_us << ",";
+		trace << "\"args\":{\"peak_rss_kb\":" << p.peak_rss_kb;
+		if( p.items >= 0 )
+			trace << ",\"items\":" << p.items;
+		trace << "}}";
+		if( i+1 < passes.size() )
+			trace << ",";
+		trace << std::endl;
+	}
+	trace << "]}" << std::endl;
+	if( !trace.good() )
+		ERROR("Error writing trace file " << filename);
+}
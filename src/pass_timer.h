@@ -0,0 +1,47 @@
+/* This file is part of onnx2c.
+ *
+ * Instrumentation of onnx2c itself: how long each compilation
+ * phase and optimization pass takes, and how much memory onnx2c
+ * has used by the end of it.
+ * Enabled with the --time-passes and --trace options.
+ */
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace toC {
+
+/* Time a phase of the compilation, from the construction of
+ * this object to its destruction. E.g.:
+ *   {
+ *     PassTimer timer("unionize");
+ *     ... do the pass ...
+ *     timer.set_items(number_of_things_done);
+ *   }
+ * Timers can nest. Does nothing unless timing is enabled
+ * in the options.
+ */
+class PassTimer {
+public:
+	PassTimer(const std::string &name);
+	~PassTimer();
+	PassTimer(const PassTimer&) = delete;
+	PassTimer& operator=(const PassTimer&) = delete;
+
+	/* Record the number of items (nodes, tensors, bytes...)
+	 * this phase handled. Shown in the report. */
+	void set_items(uint64_t items);
+
+private:
+	int record; // index into the recorded phases, negative if not timing
+};
+
+/* Print a table of all timed phases */
+void print_pass_times(std::ostream &dst);
+
+/* Write all timed phases as a Chrome trace event JSON file.
+ * Open it in chrome://tracing or https://ui.perfetto.dev */
+void write_pass_trace(const std::string &filename);
+
+}
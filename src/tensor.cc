@@ -1,3 +1,4 @@
+#include "model_loader.h"
 #include "tensor.h"
 #include "util.h"
 #include <limits>
@@ -12,8 +13,7 @@ void Tensor::parse_onnx_tensor(const onnx::TensorProto &tensor)
 	isConst = true;
 
 	// assert tensor is resolvable
-	if( onnx::TensorProto_DataLocation() != onnx::TensorProto_DataLocation_DEFAULT )
-		ERROR("unhandled: non-default data location in tensor " << tensor.name());
+	bool is_external = tensor.data_location() == onnx::TensorProto_DataLocation_EXTERNAL;
 	if( tensor.has_segment() )
 		ERROR("unhandled: segmented data in tensor" << tensor.name());
 
@@ -64,7 +64,7 @@ void Tensor::parse_onnx_tensor(const onnx::TensorProto &tensor)
 	if( data_num_elements != calc_num_data ) {
 		if( data_num_elements != 0 )
 			ERROR("Error: data size does not match dimensions, and data_num_elem is not zero");
-		else if( tensor.has_raw_data() == false )
+		else if( tensor.has_raw_data() == false && is_external == false )
 			ERROR("Error: data size does not match dimensions, and no raw data");
 	}
 
@@ -74,12 +74,36 @@ void Tensor::parse_onnx_tensor(const onnx::TensorProto &tensor)
 	if( tensor.dims().size() == 0 )
 		data_dim.push_back(1);
 
+	if( is_external ) {
+		size_t length;
+		void *external_data = get_external_tensor_data(tensor, length);
+		if( length != (uint64_t)(calc_num_data*data_elem_size()) )
+			ERROR("Error: tensor external data size does not match dimensions in tensor " << tensor.name());
+
+		// Use the weights straight from the mapped file. The pages are read in
+		// only when the initializer gets printed, and big models never need
+		// a copy of all their weights in memory.
+		// Unaligned data can't be accessed as the tensor's data type, so copy those.
+		if( (uintptr_t)external_data % data_elem_size() == 0 )
+			data_buffer = external_data;
+		else {
+			data_buffer = malloc(length);
+			if( data_buffer == NULL )
+				ERROR("memory allocation failed for tensor " << tensor.name());
+			memcpy( data_buffer, external_data, length );
+		}
+
+		name = tensor.name();
+		doc = tensor.doc_string();
+		return;
+	}
+
 	data_buffer = malloc(data_num_elem() * data_elem_size());
 	if( data_buffer == NULL )
 		ERROR("memory allocation failed for tensor " << tensor.name());
 
 	if( tensor.has_raw_data() ) {
-		std::string raw_data = tensor.raw_data(); // Yes, std::string!
+		const std::string &raw_data = tensor.raw_data(); // Yes, std::string!
 		if( raw_data.size() != (uint64_t)(calc_num_data*data_elem_size()) )
 			ERROR("Error: tensor raw data size does not match dimensions");
 
@@ -27,6 +27,9 @@ class Tensor {
 
 	std::vector<Node *> consumers;
 	int32_t union_no;     // negative for no union
+	Tensor *isAliasOf;    // if non-NULL, this tensor is not generated,
+	                      // but uses the memory of the pointed-to tensor
+	int64_t alias_offset; // starting this many elements into isAliasOf
 
 	Tensor() :
 		generate(true),
@@ -37,7 +40,9 @@ class Tensor {
 		quantizedCopy(NULL),
 		isQuantized(false),
 		data_buffer(NULL),
-		union_no(-1)
+		union_no(-1),
+		isAliasOf(NULL),
+		alias_offset(0)
 	{}
 
 	/* Create the C source name. Replace all non a-z,A-Z,0-9 or _
@@ -0,0 +1,130 @@
+/* Benchmark of the models of all tests.
+ * benchgen generates a source for each model, with a function running
+ * the model on the test inputs, and the list of the operators in the
+ * model. CMake lists the models in benchmark_all_models.h.
+ * Each model is registered as a benchmark named "<operators>/<model>".
+ * The node calls of the models are timed through the node hooks, into
+ * an array indexed by the node, and after the benchmarks the times of
+ * the nodes are summed up per operator, over all models.
+ */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+#define BENCHMARK_MODEL(name) \
+	extern "C" void name##_run(void); \
+	extern "C" const char name##_ops[]; \
+	extern "C" const unsigned name##_num_nodes; \
+	extern "C" const char *const *const name##_node_ops;
+#include "benchmark_all_models.h"
+#undef BENCHMARK_MODEL
+
+struct Model {
+	const char *name;
+	void (*run)(void);
+	const char *ops;
+	const unsigned *num_nodes;
+	const char *const *const *node_ops;
+};
+
+static const Model models[] = {
+#define BENCHMARK_MODEL(name) { #name, name##_run, name##_ops, &name##_num_nodes, &name##_node_ops },
+#include "benchmark_all_models.h"
+#undef BENCHMARK_MODEL
+};
+
+/* The time the nodes of an operator took, and how many nodes were run */
+struct OperatorTime {
+	uint64_t nodes = 0;
+	double seconds = 0;
+};
+typedef std::map<std::string, OperatorTime> OperatorTimes;
+
+// The node hooks of the generated code add the time of node 'id'
+// of the model being benchmarked to onnx2c_bench_node_seconds[id]
+extern "C" double onnx2c_bench_node_start;
+extern "C" double *onnx2c_bench_node_seconds;
+double onnx2c_bench_node_start;
+double *onnx2c_bench_node_seconds;
+
+extern "C" double onnx2c_bench_clock(void)
+{
+	std::chrono::duration<double> s = std::chrono::steady_clock::now().time_since_epoch();
+	return s.count();
+}
+
+// The nodes of each model, per operator and run of the model
+static std::map<const Model*, OperatorTimes> model_operators;
+
+static void BM_model(benchmark::State& state, const Model *model)
+{
+	unsigned num_nodes = *model->num_nodes;
+	std::vector<double> node_seconds(num_nodes + 1, 0);
+	onnx2c_bench_node_seconds = node_seconds.data();
+	uint64_t runs = 0;
+	for (auto _ : state) {
+		model->run();
+		runs++;
+	}
+	state.SetLabel(model->ops);
+
+	// benchmark calls this with more iterations until the time is
+	// long enough, so the last call is the one that gets reported
+	OperatorTimes times;
+	for( unsigned id=0; id<num_nodes; id++ ) {
+		OperatorTime &op = times[(*model->node_ops)[id]];
+		op.nodes++;
+		op.seconds += node_seconds[id] / runs;
+	}
+	model_operators[model] = times;
+}
+
+/* The usual console output, and the time per operator at the end */
+class OperatorReporter : public benchmark::ConsoleReporter
+{
+public:
+	void Finalize() override
+	{
+		OperatorTimes per_operator;
+		for( auto &model : model_operators )
+			for( auto &op : model.second ) {
+				per_operator[op.first].nodes += op.second.nodes;
+				per_operator[op.first].seconds += op.second.seconds;
+			}
+
+		size_t width = 10;
+		for( auto &op : per_operator )
+			width = std::max(width, op.first.size() + 2);
+		std::ostream &out = GetOutputStream();
+		out << std::endl;
+		out << std::left << std::setw(width) << "Operator" << std::right
+		    << std::setw(8) << "nodes" << std::setw(16) << "total us" << std::setw(16) << "avg us" << std::endl;
+		for( auto &op : per_operator ) {
+			double us = op.second.seconds * 1e6;
+			out << std::left << std::setw(width) << op.first << std::right
+			    << std::setw(8) << op.second.nodes
+			    << std::setw(16) << std::fixed << std::setprecision(3) << us
+			    << std::setw(16) << us / op.second.nodes << std::endl;
+		}
+		ConsoleReporter::Finalize();
+	}
+};
+
+int main(int argc, char **argv)
+{
+	for( auto &model : models ) {
+		std::string name = std::string(model.ops) + "/" + model.name;
+		benchmark::RegisterBenchmark(name.c_str(), BM_model, &model);
+	}
+	benchmark::Initialize(&argc, argv);
+	OperatorReporter reporter;
+	benchmark::RunSpecifiedBenchmarks(&reporter);
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Benchmark onnx2c itself (as opposed to the code it generates).
+ *
+ * Synthetic graphs of N nodes are built in memory and compiled
+ * through the same steps as main.cc does. The interesting number
+ * is how the time grows with N: it should be roughly linear,
+ * as reported by the "BigO" line of Google Benchmark.
+ *
+ * The graph is a chain of Add nodes, where each node also takes
+ * a skip connection from a node halfway back. This gives the
+ * node resolver some work to do with the dependencies.
+ */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "graph.h"
+#include "onnx.pb.h"
+#include "options.h"
+
+struct onnx2c_opts options;
+
+static void add_float_io(onnx::ValueInfoProto *vi, const std::string &name)
+{
+	vi->set_name(name);
+	onnx::TypeProto_Tensor *tt = vi->mutable_type()->mutable_tensor_type();
+	tt->set_elem_type(onnx::TensorProto_DataType_FLOAT);
+	tt->mutable_shape()->add_dim()->set_dim_value(1);
+	tt->mutable_shape()->add_dim()->set_dim_value(16);
+}
+
+// Create a model with num_nodes nodes. If 'reversed', the nodes are listed
+// in the .onnx file in the reverse order of what they need to be resolved in.
+static void create_model(onnx::ModelProto &model, int num_nodes, bool reversed)
+{
+	model.set_ir_version(7);
+	model.add_opset_import()->set_version(13);
+	onnx::GraphProto *g = model.mutable_graph();
+	add_float_io(g->add_input(), "t0");
+
+	std::vector<onnx::NodeProto> nodes;
+	for( int i=1; i<=num_nodes; i++ ) {
+		onnx::NodeProto n;
+		n.set_name("node" + std::to_string(i));
+		n.set_op_type("Add");
+		n.add_input("t" + std::to_string(i-1));
+		n.add_input("t" + std::to_string(i/2));
+		n.add_output("t" + std::to_string(i));
+		nodes.push_back(n);
+	}
+	if( reversed )
+		std::reverse(nodes.begin(), nodes.end());
+	for( auto &n : nodes )
+		*g->add_node() = n;
+
+	add_float_io(g->add_output(), "t" + std::to_string(num_nodes));
+}
+
+static void compile_model(benchmark::State& state, bool reversed, unsigned jobs=1)
+{
+	int num_nodes = state.range(0);
+	options.jobs = jobs;
+	onnx::ModelProto model;
+	create_model(model, num_nodes, reversed);
+
+	for (auto _ : state) {
+		std::ostringstream generated;
+		toC::Graph graph(model);
+		graph.unionize_tensors();
+		graph.print_source(generated);
+		benchmark::DoNotOptimize(generated);
+	}
+	state.SetComplexityN(num_nodes);
+}
+
+static void BM_compile_sorted(benchmark::State& state)
+{
+	compile_model(state, false);
+}
+static void BM_compile_reversed(benchmark::State& state)
+{
+	compile_model(state, true);
+}
+// Printing the C source with 4 threads
+static void BM_compile_sorted_j4(benchmark::State& state)
+{
+	compile_model(state, false, 4);
+}
+BENCHMARK(BM_compile_sorted)->RangeMultiplier(2)->Range(256, 8192)->Unit(benchmark::kMillisecond)->Complexity(benchmark::oN);
+BENCHMARK(BM_compile_reversed)->RangeMultiplier(2)->Range(256, 8192)->Unit(benchmark::kMillisecond)->Complexity(benchmark::oN);
+BENCHMARK(BM_compile_sorted_j4)->RangeMultiplier(2)->Range(256, 8192)->Unit(benchmark::kMillisecond)->Complexity(benchmark::oN);
+
+int main(int argc, char** argv)
+{
+	// Logging must be set up, but keep quiet - this is about speed
+	options.logging_level = 0;
+	AixLog::Log::init<AixLog::SinkCerr>(AixLog::Severity::error);
+
+	benchmark::Initialize(&argc, argv);
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
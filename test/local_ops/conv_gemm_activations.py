@@ -0,0 +1,71 @@
+# Generate a ONNX-style backend test
+# Activations after a Conv, a Gemm and MatMuls.
+# onnx2c fuses these into the preceding node.
+# HardSwish needs opset 14.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_conv_gemm_activations"
+
+A = np.random.rand( 1, 2, 4, 4 ).astype(np.float32)
+W = np.random.rand( 3, 2, 3, 3 ).astype(np.float32) - 0.5
+Bc = np.random.rand( 3 ).astype(np.float32) - 0.5
+B = np.random.rand( 5, 48 ).astype(np.float32) - 0.5
+C = np.random.rand( 5 ).astype(np.float32) - 0.5
+M1 = np.random.rand( 5, 4 ).astype(np.float32) - 0.5
+M2 = np.random.rand( 4, 3 ).astype(np.float32) - 0.5
+M3 = np.random.rand( 3, 3 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'W', W, "FLOAT")
+g = so.add_constant(g, 'Bc', Bc, "FLOAT")
+g = so.add_constant(g, 'B', B, "FLOAT")
+g = so.add_constant(g, 'C', C, "FLOAT")
+g = so.add_constant(g, 'M1', M1, "FLOAT")
+g = so.add_constant(g, 'M2', M2, "FLOAT")
+g = so.add_constant(g, 'M3', M3, "FLOAT")
+g = so.add_constant(g, 'cmin', np.array(-0.16, dtype=np.float32), "FLOAT")
+g = so.add_constant(g, 'cmax', np.array(0.05, dtype=np.float32), "FLOAT")
+
+n1 = so.node('Conv', inputs=['data', 'W', 'Bc'], outputs=['conv'], pads=[1,1,1,1])
+n2 = so.node('Relu', inputs=['conv'], outputs=['relu'])
+n3 = so.node('Flatten', inputs=['relu'], outputs=['flat'])
+n4 = so.node('Gemm', inputs=['flat', 'B', 'C'], outputs=['gemm'], transB=1)
+n5 = so.node('LeakyRelu', inputs=['gemm'], outputs=['leaky'], alpha=0.1)
+n6 = so.node('MatMul', inputs=['leaky', 'M1'], outputs=['mm1'])
+n7 = so.node('HardSwish', inputs=['mm1'], outputs=['hswish'])
+n8 = so.node('MatMul', inputs=['hswish', 'M2'], outputs=['mm2'])
+n9 = so.node('Sigmoid', inputs=['mm2'], outputs=['sigm'])
+n10 = so.node('MatMul', inputs=['sigm', 'M3'], outputs=['mm3'])
+n11 = so.node('Clip', inputs=['mm3', 'cmin', 'cmax'], outputs=['O'])
+
+for n in [n1, n2, n3, n4, n5, n6, n7, n8, n9, n10, n11]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'data', "FLOAT", A.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1,3))
+
+
+so.check(g)
+
+example = {
+	"data": A,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx", onnx_opset_version=14)
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(A, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
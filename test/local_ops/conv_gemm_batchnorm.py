@@ -0,0 +1,63 @@
+# Generate a ONNX-style backend test
+# BatchNormalization nodes after a Conv (without bias) and a Gemm.
+# onnx2c folds these into the weights of the preceding node.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_conv_gemm_batchnorm"
+
+A = np.random.rand( 1, 2, 4, 4 ).astype(np.float32)
+W = np.random.rand( 3, 2, 3, 3 ).astype(np.float32) - 0.5
+B = np.random.rand( 5, 48 ).astype(np.float32) - 0.5
+C = np.random.rand( 5 ).astype(np.float32)
+
+def bn_params(g, prefix, n):
+	g = so.add_constant(g, prefix+'_scale', np.random.rand(n).astype(np.float32) + 0.5, "FLOAT")
+	g = so.add_constant(g, prefix+'_bias', np.random.rand(n).astype(np.float32) - 0.5, "FLOAT")
+	g = so.add_constant(g, prefix+'_mean', np.random.rand(n).astype(np.float32) - 0.5, "FLOAT")
+	g = so.add_constant(g, prefix+'_var', np.random.rand(n).astype(np.float32) + 0.1, "FLOAT")
+	return g
+
+g = so.empty_graph()
+g = so.add_constant(g, 'W', W, "FLOAT")
+g = so.add_constant(g, 'B', B, "FLOAT")
+g = so.add_constant(g, 'C', C, "FLOAT")
+g = bn_params(g, 'bn1', 3)
+g = bn_params(g, 'bn2', 5)
+
+n1 = so.node('Conv', inputs=['data', 'W'], outputs=['conv'], pads=[1,1,1,1])
+n2 = so.node('BatchNormalization', inputs=['conv', 'bn1_scale', 'bn1_bias', 'bn1_mean', 'bn1_var'], outputs=['bn1'])
+n3 = so.node('Flatten', inputs=['bn1'], outputs=['flat'])
+n4 = so.node('Gemm', inputs=['flat', 'B', 'C'], outputs=['gemm'], transB=1)
+n5 = so.node('BatchNormalization', inputs=['gemm', 'bn2_scale', 'bn2_bias', 'bn2_mean', 'bn2_var'], outputs=['O'])
+
+for n in [n1, n2, n3, n4, n5]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'data', "FLOAT", A.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1,5))
+
+
+so.check(g)
+
+example = {
+	"data": A,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(A, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
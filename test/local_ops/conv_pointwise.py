@@ -0,0 +1,54 @@
+# Generate a ONNX-style backend test
+# Pointwise (1x1, stride 1, no padding) convolutions, which onnx2c
+# calculates as matrix multiplications in blocks of output channels
+# and outputs. The sizes are not multiples of the blocks.
+# The first one has a bias and a Relu.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_conv_pointwise"
+
+A = np.random.rand( 1, 6, 5, 7 ).astype(np.float32) - 0.5
+W1 = np.random.rand( 9, 6, 1, 1 ).astype(np.float32) - 0.5
+B1 = np.random.rand( 9 ).astype(np.float32) - 0.5
+W2 = np.random.rand( 5, 9, 1, 1 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'W1', W1, "FLOAT")
+g = so.add_constant(g, 'B1', B1, "FLOAT")
+g = so.add_constant(g, 'W2', W2, "FLOAT")
+
+n1 = so.node('Conv', inputs=['data', 'W1', 'B1'], outputs=['conv1'])
+n2 = so.node('Relu', inputs=['conv1'], outputs=['relu'])
+n3 = so.node('Conv', inputs=['relu', 'W2'], outputs=['O'])
+
+for n in [n1, n2, n3]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'data', "FLOAT", A.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1,5,5,7))
+
+
+so.check(g)
+
+example = {
+	"data": A,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(A, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
@@ -0,0 +1,59 @@
+# Generate a ONNX-style backend test
+# 3x3 convolutions with stride 1, which onnx2c can calculate with
+# the Winograd transform: F(4x4,3x3) for the first two, and
+# F(2x2,3x3) for the last one, whose output is too small for 4x4 tiles.
+# The output sizes are not multiples of the tiles.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_conv_winograd"
+
+A = np.random.rand( 1, 5, 13, 11 ).astype(np.float32) - 0.5
+W1 = np.random.rand( 6, 5, 3, 3 ).astype(np.float32) - 0.5
+B1 = np.random.rand( 6 ).astype(np.float32) - 0.5
+W2 = np.random.rand( 7, 6, 3, 3 ).astype(np.float32) - 0.5
+W3 = np.random.rand( 4, 7, 3, 3 ).astype(np.float32) - 0.5
+B3 = np.random.rand( 4 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'W1', W1, "FLOAT")
+g = so.add_constant(g, 'B1', B1, "FLOAT")
+g = so.add_constant(g, 'W2', W2, "FLOAT")
+g = so.add_constant(g, 'W3', W3, "FLOAT")
+g = so.add_constant(g, 'B3', B3, "FLOAT")
+
+n1 = so.node('Conv', inputs=['data', 'W1', 'B1'], outputs=['conv1'], pads=[1,1,1,1])
+n2 = so.node('Relu', inputs=['conv1'], outputs=['relu'])
+n3 = so.node('Conv', inputs=['relu', 'W2'], outputs=['conv2'])
+n4 = so.node('Conv', inputs=['conv2', 'W3', 'B3'], outputs=['O'])
+
+for n in [n1, n2, n3, n4]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'data', "FLOAT", A.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1,4,9,7))
+
+
+so.check(g)
+
+example = {
+	"data": A,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(A, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
@@ -0,0 +1,58 @@
+# Generate a ONNX-style backend test
+# A chain of elementwise nodes, with broadcasting and a SiLU in it.
+# onnx2c fuses these into single loops. The Add's output is needed
+# also by the Neg, so that gets calculated in its own loop.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_elementwise_fusion"
+
+X = (np.random.rand( 2, 3, 4 ).astype(np.float32) - 0.5) * 4
+S = np.random.rand( 4 ).astype(np.float32) + 0.5
+B = np.random.rand( 3, 1 ).astype(np.float32) - 0.5
+C = np.random.rand( 1 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'S', S, "FLOAT")
+g = so.add_constant(g, 'B', B, "FLOAT")
+g = so.add_constant(g, 'C', C, "FLOAT")
+
+n1 = so.node('Mul', inputs=['X', 'S'], outputs=['scaled'])
+n2 = so.node('Add', inputs=['scaled', 'B'], outputs=['biased'])
+n3 = so.node('Sigmoid', inputs=['biased'], outputs=['gate'])
+n4 = so.node('Mul', inputs=['biased', 'gate'], outputs=['silu'])
+n5 = so.node('Sum', inputs=['silu', 'X', 'C'], outputs=['O'])
+n6 = so.node('Neg', inputs=['biased'], outputs=['O2'])
+
+for n in [n1, n2, n3, n4, n5, n6]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'X', "FLOAT", X.shape)
+
+g = so.add_output(g, 'O', "FLOAT", X.shape)
+g = so.add_output(g, 'O2', "FLOAT", X.shape)
+
+
+so.check(g)
+
+example = {
+	"X": X,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O", "O2"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(X, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
+save_tensor(result[1], test_name + "/test_data_set_0/output_1.pb")
@@ -0,0 +1,65 @@
+# Generate a ONNX-style backend test
+# A graph with a shape computing subgraph and other nodes whose
+# inputs are all constants. onnx2c folds these at compile time.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_fold_constants"
+
+A = np.random.rand( 2, 3, 4 ).astype(np.float32)
+
+g = so.empty_graph()
+g = so.add_constant(g, 'gather_idx', np.array([0], dtype=np.int64), "INT64")
+g = so.add_constant(g, 'minus_one', np.array([-1], dtype=np.int64), "INT64")
+g = so.add_constant(g, 'start', np.array(0, dtype=np.float32), "FLOAT")
+g = so.add_constant(g, 'limit', np.array(12, dtype=np.float32), "FLOAT")
+g = so.add_constant(g, 'delta', np.array(1, dtype=np.float32), "FLOAT")
+g = so.add_constant(g, 'expand_shape', np.array([2, 12], dtype=np.int64), "INT64")
+g = so.add_constant(g, 'half_shape', np.array([12], dtype=np.int64), "INT64")
+
+# Reshape 'data' to [batch, -1]
+n1 = so.node('Shape', inputs=['data'], outputs=['data_shape'])
+n2 = so.node('Gather', inputs=['data_shape', 'gather_idx'], outputs=['batch'], axis=0)
+n3 = so.node('Concat', inputs=['batch', 'minus_one'], outputs=['new_shape'], axis=0)
+n4 = so.node('Reshape', inputs=['data', 'new_shape'], outputs=['reshaped'])
+# A [2,12] tensor of 0..11 on each row
+n5 = so.node('Range', inputs=['start', 'limit', 'delta'], outputs=['range'])
+n6 = so.node('Expand', inputs=['range', 'expand_shape'], outputs=['expanded'])
+# 0.5 * batch = 1.0
+n7 = so.node('ConstantOfShape', inputs=['half_shape'], outputs=['halves'],
+             value=numpy_helper.from_array(np.array([0.5], dtype=np.float32)))
+n8 = so.node('Cast', inputs=['batch'], outputs=['batch_f'], to=1)
+n9 = so.node('Mul', inputs=['halves', 'batch_f'], outputs=['ones'])
+n10 = so.node('Add', inputs=['reshaped', 'expanded'], outputs=['sum'])
+n11 = so.node('Add', inputs=['sum', 'ones'], outputs=['O'])
+
+for n in [n1, n2, n3, n4, n5, n6, n7, n8, n9, n10, n11]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'data', "FLOAT", A.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (2,12))
+
+
+so.check(g)
+
+example = {
+	"data": A,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(A, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
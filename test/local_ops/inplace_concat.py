@@ -0,0 +1,59 @@
+# Generate a ONNX-style backend test
+# Concat nodes, where onnx2c can calculate the inputs in place in
+# the output (channels with batch size 1, and the output being
+# a graph output), and where it can't (concatenating along
+# an inner axis, and a graph input).
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_inplace_concat"
+
+X = (np.random.rand( 1, 2, 3, 4 ).astype(np.float32) - 0.5) * 4
+M = np.random.rand( 1, 2, 3, 4 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'M', M, "FLOAT")
+
+n1 = so.node('Relu', inputs=['X'], outputs=['relu'])
+n2 = so.node('Mul', inputs=['X', 'M'], outputs=['scaled'])
+n3 = so.node('Concat', inputs=['relu', 'scaled'], outputs=['channels'], axis=1)
+n4 = so.node('Sigmoid', inputs=['channels'], outputs=['O'])
+n5 = so.node('Neg', inputs=['X'], outputs=['neg'])
+n6 = so.node('Concat', inputs=['neg', 'X'], outputs=['O2'], axis=2)
+n7 = so.node('Abs', inputs=['X'], outputs=['abs'])
+n8 = so.node('Concat', inputs=['abs', 'X'], outputs=['O3'], axis=0)
+
+for n in [n1, n2, n3, n4, n5, n6, n7, n8]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'X', "FLOAT", X.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1, 4, 3, 4))
+g = so.add_output(g, 'O2', "FLOAT", (1, 2, 6, 4))
+g = so.add_output(g, 'O3', "FLOAT", (2, 2, 3, 4))
+
+
+so.check(g)
+
+example = {
+	"X": X,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O", "O2", "O3"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(X, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
+save_tensor(result[1], test_name + "/test_data_set_0/output_1.pb")
+save_tensor(result[2], test_name + "/test_data_set_0/output_2.pb")
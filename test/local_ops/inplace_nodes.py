@@ -0,0 +1,63 @@
+# Generate a ONNX-style backend test
+# A chain of nodes that onnx2c can calculate in place, over their
+# input. 'a' is used by both Relu and Sigmoid, so Relu can't write
+# over it, but the (fused) Sigmoid+Add can, as it runs after the Relu.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_inplace_nodes"
+
+X = (np.random.rand( 2, 6 ).astype(np.float32) - 0.5) * 4
+M = (np.random.rand( 2, 6 ).astype(np.float32) - 0.5) * 2
+scale = np.random.rand( 6 ).astype(np.float32) + 0.5
+bias = np.random.rand( 6 ).astype(np.float32) - 0.5
+mean = np.random.rand( 6 ).astype(np.float32) - 0.5
+var = np.random.rand( 6 ).astype(np.float32) + 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'M', M, "FLOAT")
+g = so.add_constant(g, 'scale', scale, "FLOAT")
+g = so.add_constant(g, 'bias', bias, "FLOAT")
+g = so.add_constant(g, 'mean', mean, "FLOAT")
+g = so.add_constant(g, 'var', var, "FLOAT")
+g = so.add_constant(g, 'min', np.array(-0.5, dtype=np.float32), "FLOAT")
+g = so.add_constant(g, 'max', np.array(0.5, dtype=np.float32), "FLOAT")
+
+n1 = so.node('Mul', inputs=['X', 'M'], outputs=['a'])
+n2 = so.node('Relu', inputs=['a'], outputs=['b'])
+n3 = so.node('Sigmoid', inputs=['a'], outputs=['c'])
+n4 = so.node('Add', inputs=['b', 'c'], outputs=['d'])
+n5 = so.node('Softmax', inputs=['d'], outputs=['e'], axis=-1)
+n6 = so.node('BatchNormalization', inputs=['e', 'scale', 'bias', 'mean', 'var'], outputs=['f'], epsilon=1e-5)
+n7 = so.node('Clip', inputs=['f', 'min', 'max'], outputs=['O'])
+
+for n in [n1, n2, n3, n4, n5, n6, n7]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'X', "FLOAT", X.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (2, 6))
+
+
+so.check(g)
+
+example = {
+	"X": X,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(X, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
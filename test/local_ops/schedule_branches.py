@@ -0,0 +1,52 @@
+# Generate a ONNX-style backend test
+# Four branches that each widen the input and then narrow it down,
+# listed so that all the wide tensors are calculated first.
+# onnx2c's node scheduling should run one branch at a time.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_schedule_branches"
+K = 4
+
+X = (np.random.rand( 1, 8 ).astype(np.float32) - 0.5) * 2
+
+g = so.empty_graph()
+for k in range(K):
+	W1 = np.random.rand( 8, 64 ).astype(np.float32) - 0.5
+	W2 = np.random.rand( 64, 2 ).astype(np.float32) - 0.5
+	g = so.add_constant(g, 'W1_' + str(k), W1, "FLOAT")
+	g = so.add_constant(g, 'W2_' + str(k), W2, "FLOAT")
+
+for k in range(K):
+	g = so.add_node(g, so.node('MatMul', inputs=['X', 'W1_' + str(k)], outputs=['H' + str(k)]))
+for k in range(K):
+	g = so.add_node(g, so.node('MatMul', inputs=['H' + str(k), 'W2_' + str(k)], outputs=['S' + str(k)]))
+g = so.add_node(g, so.node('Sum', inputs=['S' + str(k) for k in range(K)], outputs=['O']))
+g = so.add_input(g, 'X', "FLOAT", X.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (1, 2))
+
+
+so.check(g)
+
+example = {
+	"X": X,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(X, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
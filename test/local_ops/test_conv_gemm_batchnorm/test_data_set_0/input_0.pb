@@ -0,0 +1 @@
+"qG?Y>?jS>5P?R?I'?8$>J?ѧ>!>s?\?6=3\?j?a>h6>,?>/?n)?l+>D?o{?)x??J5=;0	>p?>
\ No newline at end of file
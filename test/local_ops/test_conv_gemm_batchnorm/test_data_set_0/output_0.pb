@@ -0,0 +1 @@
+"˶a2@H@)	@=
\ No newline at end of file
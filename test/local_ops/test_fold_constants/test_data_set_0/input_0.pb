@@ -0,0 +1 @@
+"`hͥ>5x>&?zY=/	?;>Hm=O?=>\=ǹ=Z>S?=d>w ?r??>y?{>=[?G>
\ No newline at end of file
@@ -0,0 +1 @@
+"`Zs?	@i@fQ@%@@!@uAA6&A!1AsAAV?%4@_G@$@@S@w@XAA; AI=A=DA
\ No newline at end of file
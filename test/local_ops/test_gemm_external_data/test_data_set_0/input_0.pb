@@ -0,0 +1 @@
+J5K?vC>OG?xm=P-?m?
\ No newline at end of file
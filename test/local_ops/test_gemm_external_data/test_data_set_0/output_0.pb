@@ -0,0 +1 @@
+J :B@R@@N?@*@6i@gb@x%@
\ No newline at end of file
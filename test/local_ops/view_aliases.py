@@ -0,0 +1,55 @@
+# Generate a ONNX-style backend test
+# A chain of nodes that only change the shape of the graph input.
+# onnx2c makes their outputs aliases of the input, except for the
+# last Squeeze, that writes the graph output.
+import numpy as np
+import sclblonnx as so
+from onnx import helper, numpy_helper
+from pathlib import Path
+
+test_name="test_view_aliases"
+
+X = (np.random.rand( 2, 6 ).astype(np.float32) - 0.5) * 4
+M = np.random.rand( 12 ).astype(np.float32) - 0.5
+
+g = so.empty_graph()
+g = so.add_constant(g, 'shape', np.array([3, 4], dtype=np.int64), "INT64")
+g = so.add_constant(g, 'axes', np.array([0], dtype=np.int64), "INT64")
+g = so.add_constant(g, 'M', M, "FLOAT")
+
+n1 = so.node('Reshape', inputs=['X', 'shape'], outputs=['reshaped'])
+n2 = so.node('Unsqueeze', inputs=['reshaped', 'axes'], outputs=['unsqueezed'])
+n3 = so.node('Flatten', inputs=['unsqueezed'], outputs=['flat'], axis=1)
+n4 = so.node('Dropout', inputs=['flat'], outputs=['dropped'])
+n5 = so.node('Mul', inputs=['dropped', 'M'], outputs=['scaled'])
+n6 = so.node('Relu', inputs=['scaled'], outputs=['relu'])
+n7 = so.node('Squeeze', inputs=['relu', 'axes'], outputs=['O'])
+
+for n in [n1, n2, n3, n4, n5, n6, n7]:
+	g = so.add_node(g, n)
+g = so.add_input(g, 'X', "FLOAT", X.shape)
+
+g = so.add_output(g, 'O', "FLOAT", (12,))
+
+
+so.check(g)
+
+example = {
+	"X": X,
+}
+Path(test_name + "/test_data_set_0").mkdir(parents=True, exist_ok=True)
+so.graph_to_file(g, test_name + "/model.onnx")
+result = so.run(g,
+                inputs=example,
+                outputs=["O"]
+                )
+print(result)
+
+
+def save_tensor(t, fn):
+	with open(fn, 'wb') as f:
+		npt = numpy_helper.from_array(t)
+		f.write(npt.SerializeToString(npt))
+
+save_tensor(X, test_name + "/test_data_set_0/input_0.pb")
+save_tensor(result[0], test_name + "/test_data_set_0/output_0.pb")
@@ -3,11 +3,18 @@
  * This test is mostly a regression for BatchNorm optimizations.
  */ 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 /* Entry to the neural network. (TODO: how about generating a header?) */
 extern "C" {
 void entry(float input[1][28*28], float output[1][10]);
+#ifdef WEIGHTS_FILE
+int entry_init(const void *weights, size_t len);
+#endif
+#ifdef ONNX2C_PROFILE
+void onnx2c_print_profile(FILE *f);
+#endif
 }
 
 /* make the window wide enough or the font small enough for some ascii art :) */
@@ -46,8 +53,33 @@ float input_seven [1][28*28] = {{
 float results[10] = {
 1.04808474, -1.25860775, -6.02781439, 2.02120113, 1.64859867, 4.39240599, -3.22019339, 4.72483015, -1.96882212, -0.978904724};
 
+#ifdef WEIGHTS_FILE
+/* The network was compiled with --weights-file, and the weights
+ * file is given on the command line */
+int main(int argc, char *argv[])
+{
+	if( argc < 2 )
+		return 1;
+	FILE *f = fopen(argv[1], "rb");
+	if( f == NULL )
+		return 1;
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	void *weights = malloc(len);
+	if( fread(weights, 1, len, f) != (size_t)len )
+		return 1;
+	fclose(f);
+
+	// A truncated file must be rejected
+	if( entry_init(weights, len-1) == 0 )
+		return 1;
+	if( entry_init(weights, len) != 0 )
+		return 1;
+#else
 int main(void)
 {
+#endif
 	float output_seven[1][10];
 	entry(input_seven, output_seven);
 	for(int i=0; i<10; i++ ){
@@ -55,6 +87,9 @@ int main(void)
 			return 1;
 	}
 
+#ifdef ONNX2C_PROFILE
+	onnx2c_print_profile(stdout);
+#endif
 
 	return 0;
 }
@@ -0,0 +1,136 @@
+/*
+ * Generate a benchmark C source from an ONNX "standard" test directory.
+ * (see e.g. onnx/onnx/backend/test/data/node/test_add/ for an example)
+ * Like testgen, but instead of a main() checking the results, the
+ * source has functions for the benchmark harness
+ * (test/benchmarks/host/benchmark_all.cc):
+ *   void <name>_run(void);     runs the network once on the test inputs
+ *   const char <name>_ops[];   the operators in the model, e.g. "Conv+Relu"
+ *   const unsigned <name>_num_nodes;         the number of node calls
+ *   const char *const *const <name>_node_ops; the operator of each node call
+ * The network is in the same file, with entry() renamed to <name>_entry(),
+ * so that any number of these can be linked into one binary.
+ * The node calls in it are wrapped in the --node-hooks macros, which
+ * add the time of each call to onnx2c_bench_node_seconds[id] of the
+ * harness, with its onnx2c_bench_clock().
+ * Any further arguments are passed on to onnx2c as options, e.g. to
+ * benchmark an optimization pass that is off by default.
+ * The source is printed out on stdout.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "graph.h"
+#include "model_loader.h"
+#include "onnx.pb.h"
+#include "options.h"
+#include "tensor.h"
+#include "test_data_loader.h"
+#include "util.h"
+
+using namespace toC;
+
+int main(int argc, char *argv[])
+{
+	if( argc < 3 ) {
+		std::cerr << "Usage:" << std::endl;
+		std::cerr << "./benchgen <directory> <name> [onnx2c options]" << std::endl;
+		std::cerr << std::endl;
+		std::cerr << " <directory> is the directory that contains the test - i.e. 'model.onnx' and test_data_set_0" << std::endl;
+		std::cerr << " <name> is the prefix of the functions in the generated source" << std::endl;
+		exit(1);
+	}
+
+	onnx::ModelProto onnx_model;
+	std::string dir(argv[1]);
+	std::string name = cify_name(argv[2]);
+	std::string model_fn = dir + "/model.onnx";
+
+	// The onnx2c options, as if given on the onnx2c command line
+	std::vector<const char*> onnx2c_args = { argv[0] };
+	for( int i=3; i<argc; i++ )
+		onnx2c_args.push_back(argv[i]);
+	onnx2c_args.push_back(model_fn.c_str());
+	options.logging_level = 1;
+	parse_cmdline_options(onnx2c_args.size(), onnx2c_args.data());
+
+	// Beware of user having locale support on! Test suite feeds floats with the decimal dot format.
+	setlocale(LC_NUMERIC, "C");
+
+	std::vector<Tensor*> inputs;
+	std::vector<Tensor*> outputs;
+	std::vector<Tensor*> references;
+	load_test_data_set(dir + "/test_data_set_0", inputs, outputs, references);
+
+	if( load_onnx_model(model_fn, onnx_model) == false ) {
+		std::cerr << "Error reading model file: " << model_fn << std::endl;
+		exit(1);
+	}
+
+	// The operators, in the order they first appear in the model.
+	// Constants are calculated at compile time.
+	std::vector<std::string> ops;
+	for( auto &n : onnx_model.graph().node() )
+		if( n.op_type() != "Constant"
+		 && std::find(ops.begin(), ops.end(), n.op_type()) == ops.end() )
+			ops.push_back(n.op_type());
+
+	// As in testgen, the inputs are passed to the Graph
+	Graph toCgraph(onnx_model, inputs);
+
+	std::cout << "// Benchmark of " << dir << std::endl;
+	std::cout << "#define entry " << name << "_entry" << std::endl;
+	std::cout << "double onnx2c_bench_clock(void);" << std::endl;
+	std::cout << "extern double onnx2c_bench_node_start;" << std::endl;
+	std::cout << "extern double *onnx2c_bench_node_seconds;" << std::endl;
+	std::cout << "#define ONNX2C_NODE_BEGIN(id, name) onnx2c_bench_node_start = onnx2c_bench_clock()" << std::endl;
+	std::cout << "#define ONNX2C_NODE_END(id) onnx2c_bench_node_seconds[id] += onnx2c_bench_clock() - onnx2c_bench_node_start" << std::endl;
+	std::cout.precision(20);
+	options.node_hooks = true;
+	toCgraph.optimize();
+	toCgraph.print_source(std::cout);
+	std::cout << "#undef entry" << std::endl;
+	std::cout << std::endl;
+
+	for( auto i : inputs) {
+		std::cout << "static ";
+		i->print_tensor(std::cout, false, "graphin_" + i->cname());
+		std::cout << " = ";
+		i->print_tensor_initializer(std::cout);
+		std::cout << ";" << std::endl;
+	}
+	for( auto o : outputs) {
+		std::cout << "static ";
+		o->print_tensor(std::cout, false, "graphout_" + o->cname());
+		std::cout << ";" << std::endl;
+	}
+	std::cout << std::endl;
+
+	std::cout << "void " << name << "_run(void)" << std::endl;
+	std::cout << "{" << std::endl;
+	std::cout << "\t" << name << "_entry(";
+	bool isfirst = true;
+	for( auto i : inputs) {
+		if( isfirst ) isfirst=false;
+		else          std::cout << ", ";
+		std::cout << "graphin_" + i->cname();
+	}
+	for( auto o : outputs ) {
+		if( isfirst ) isfirst=false;
+		else          std::cout << ", ";
+		std::cout << "graphout_" + o->cname();
+	}
+	std::cout << ");" << std::endl;
+	std::cout << "}" << std::endl;
+	std::cout << std::endl;
+
+	std::cout << "const char " << name << "_ops[] = \"";
+	for( unsigned i=0; i<ops.size(); i++ )
+		std::cout << (i > 0 ? "+" : "") << cify_name(ops[i]);
+	std::cout << "\";" << std::endl;
+	std::cout << "const unsigned " << name << "_num_nodes = ONNX2C_NUM_NODES;" << std::endl;
+	std::cout << "const char *const *const " << name << "_node_ops = onnx2c_node_ops;" << std::endl;
+	return 0;
+}
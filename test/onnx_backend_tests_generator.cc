@@ -4,6 +4,9 @@
  * This takes as paramters the directory where the test is and 
  * which of the test inputs in that test directory to use.
  * (see the "Usage" error print at start of main()).
+ * Optionally, the references are calculated by another compilation of
+ * the network, with its entry() renamed, instead of read from the test
+ * data set. E.g. to check an optimization against the default code.
  * The final test source is printed out on stdout.
  */
 
@@ -12,63 +15,26 @@
 #include <fstream>
 
 #include "graph.h"
+#include "model_loader.h"
 #include "onnx.pb.h"
 #include "options.h"
 #include "tensor.h"
-
-#include <google/protobuf/io/coded_stream.h>
-#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include "test_data_loader.h"
 
 using namespace toC;
 
 struct onnx2c_opts options;
 
-bool load_input_data(const std::string &filename, onnx::TensorProto &result)
-{
-
-	/* TODO: read Protobuffers documentation. This is lifted from
-	 * ONNX code - looks like there could be a more C++ way to do this */ 
-	FILE *f = fopen(filename.c_str(), "rb");
-	if( f == NULL )
-		return false;
-	fseek(f, 0, SEEK_END);
-	int size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-
-	char data[size];
-	int nread = fread(data, 1, size, f);
-	fclose(f);
-
-	if( nread != size )
-		ERROR("Problem reading input data");
-
-	::google::protobuf::io::ArrayInputStream input_stream(data, size);
-	::google::protobuf::io::CodedInputStream coded_stream(&input_stream);
-	return result.ParseFromCodedStream(&coded_stream);
-}
-
-Tensor * get_input_from_file( std::string &partial_path, int input_number )
-{
-	onnx::TensorProto tensor;
-	std::string input_fn = partial_path + std::to_string(input_number) + ".pb";
-	
-	if( load_input_data(input_fn, tensor) == false )
-		return NULL;
-
-	Tensor *t = new Tensor;
-	t->parse_onnx_tensor(tensor);
-	return t;
-}
-
 int main(int argc, char *argv[])
 {
 	if( argc < 4 ) {
 		std::cerr << "Usage:" << std::endl;
-		std::cerr << "./onnx_backend_tests_runner <directory> <accuracy> <test_data_set>" << std::endl;
+		std::cerr << "./onnx_backend_tests_runner <directory> <accuracy> <test_data_set> [reference function]" << std::endl;
 		std::cerr << std::endl;
 		std::cerr << " <directory> is the directory that contains the test - i.e. 'model.onnx' and test_data_set_0" << std::endl;
 		std::cerr << " <accuracy> floating point value: the maximum allowed difference between result and refrence. Use decimal dot, not comma!"<< std::endl;
 		std::cerr << " <test_data_set> integer value: select the test dataset to run this test against. (Most tests have only 0)" << std::endl;
+		std::cerr << " [reference function] the entry() of the network compiled otherwise, to calculate the references with" << std::endl;
 		exit(1);
 	}
 
@@ -81,67 +47,18 @@ int main(int argc, char *argv[])
 	// Beware of user having locale support on! Test suite feeds floats with the decimal dot format.
 	setlocale(LC_NUMERIC, "C");
 	float test_accuracy = std::stod(argv[2]);
+	std::string reference_function = argc > 4 ? argv[4] : "";
 
 	std::vector<Tensor*> inputs;
 	std::vector<Tensor*> outputs;
 	std::vector<Tensor*> references;
 
 	std::string dataset_dir = dir + "/test_data_set_" + argv[3];
-
-
-	int input_number=0;
-	while(true) {
-		std::string partial = dataset_dir + "/input_";
-		Tensor *t = get_input_from_file(partial, input_number);
-		if( t == NULL )
-			break;
-		t->isIO = true;
-		// Don't write the initialization from the onnx2c graph
-		// It is written from the test suite, which is part of "the application",
-		// not the neural net
-		t->initialize = false;
-		t->generate = false;
-		t->isConst=true;
-		if( t->name == "" )
-			t->name = std::string("input_") + std::to_string(input_number);
-	
-		inputs.push_back(t);
-		input_number++;
-	}
-
-	input_number=0;
-	while(true) {
-		std::string partial = dataset_dir + "/output_";
-		Tensor *ref = get_input_from_file(partial, input_number);
-		Tensor *out = get_input_from_file(partial, input_number);
-		if( ref == NULL || out == NULL )
-			break;
-		ref->generate=true;
-		ref->initialize=true;
-		out->generate=true;
-		out->initialize=false;
-		out->isConst=false;
-		// Just in case the network needs to zero-initialize the output buffer (e.g. LSTM)
-		out->data_buffer = NULL;
-		out->isIO = true;
-		if( ref->name == "" ) {
-			ref->name = std::string("output_") + std::to_string(input_number);
-			out->name = std::string("output_") + std::to_string(input_number);
-		}
-
-		references.push_back(ref);
-		outputs.push_back(out);
-		input_number++;
-	}
+	load_test_data_set(dataset_dir, inputs, outputs, references);
 
 
 	// Read in model
 	std::string model_fn = dir + "/model.onnx";
-	std::ifstream model_ifs(model_fn);
-	if (!model_ifs.good()) {
-		std::cerr << "Error opening model file: " << model_fn << std::endl;
-		exit(1); //TODO: check out error numbers for a more accurate one
-	}
 
 	// We pass in the testsuite's tensors to the Graph, so it
 	// can mark IO tensors as 'initialized'.
@@ -150,7 +67,10 @@ int main(int argc, char *argv[])
 	std::vector <Tensor *> tensors_to_parser;
 	for( auto i : inputs) tensors_to_parser.push_back(i);
 
-	onnx_model.ParseFromIstream(&model_ifs);
+	if( load_onnx_model(model_fn, onnx_model) == false ) {
+		std::cerr << "Error reading model file: " << model_fn << std::endl;
+		exit(1); //TODO: check out error numbers for a more accurate one
+	}
 	Graph toCgraph(onnx_model, tensors_to_parser);
 
 	// Optionally, genrerate the network into the same file as the test harness.
@@ -163,7 +83,7 @@ int main(int argc, char *argv[])
 	// constants)
 #if defined TESTGEN_SINGLEFILE
 	std::cout.precision(20);
-	toCgraph.unionize_tensors();
+	toCgraph.optimize();
 	toCgraph.print_source(std::cout);
 	std::cout << std::endl << std::endl;
 	std::cout << "/////////////////////////////////////"<<std::endl;
@@ -178,6 +98,11 @@ int main(int argc, char *argv[])
 	std::cout << "#include <stdint.h>"<<std::endl;
 	toCgraph.print_interface_function(std::cout, false); // false==declaration
 #endif
+	if( reference_function != "" ) {
+		std::cout << "#define entry " << reference_function << std::endl;
+		toCgraph.print_interface_function(std::cout, false);
+		std::cout << "#undef entry" << std::endl;
+	}
 
 	for( auto i : inputs) {
 		std::string refname = "graphin_" + i->cname();
@@ -196,16 +121,37 @@ int main(int argc, char *argv[])
 	// print the reference tensors
 	for( auto o : references ) {
 		std::string refname = "reference_" + o->cname();
+		// The reference function writes them
+		if( reference_function != "" )
+			o->isConst = false;
 		std::cout << "static ";
 		o->print_tensor(std::cout, false, refname);
-		std::cout << " = ";
-		o->print_tensor_initializer(std::cout);
+		if( reference_function == "" ) {
+			std::cout << " = ";
+			o->print_tensor_initializer(std::cout);
+		}
 		std::cout << ";" << std::endl;
 	}
 
 
 	std::cout <<         "int main(void) {" << std::endl;
 
+	if( reference_function != "" ) {
+		std::cout << "\t" << reference_function << "(";
+		bool isfirst = true;
+		for( auto i : inputs) {
+			if( isfirst ) isfirst=false;
+			else          std::cout << ", ";
+			std::cout << "graphin_" + i->cname();
+		}
+		for( auto r : references ) {
+			if( isfirst ) isfirst=false;
+			else          std::cout << ", ";
+			std::cout << "reference_" + r->cname();
+		}
+		std::cout << ");" << std::endl;
+	}
+
 	// run inference on the network
 	std::cout << "\t"<<  "entry(";
 	bool isfirst = true;
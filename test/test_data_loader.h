@@ -0,0 +1,109 @@
+/* This file is part of onnx2c.
+ *
+ * Reading the inputs and outputs of an ONNX "standard" test
+ * directory, for testgen and benchgen.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "onnx.pb.h"
+#include "tensor.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+inline bool load_input_data(const std::string &filename, onnx::TensorProto &result)
+{
+
+	/* TODO: read Protobuffers documentation. This is lifted from
+	 * ONNX code - looks like there could be a more C++ way to do this */ 
+	FILE *f = fopen(filename.c_str(), "rb");
+	if( f == NULL )
+		return false;
+	fseek(f, 0, SEEK_END);
+	int size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char data[size];
+	int nread = fread(data, 1, size, f);
+	fclose(f);
+
+	if( nread != size )
+		ERROR("Problem reading input data");
+
+	::google::protobuf::io::ArrayInputStream input_stream(data, size);
+	::google::protobuf::io::CodedInputStream coded_stream(&input_stream);
+	return result.ParseFromCodedStream(&coded_stream);
+}
+
+inline toC::Tensor * get_input_from_file( std::string &partial_path, int input_number )
+{
+	onnx::TensorProto tensor;
+	std::string input_fn = partial_path + std::to_string(input_number) + ".pb";
+	
+	if( load_input_data(input_fn, tensor) == false )
+		return NULL;
+
+	toC::Tensor *t = new toC::Tensor;
+	t->parse_onnx_tensor(tensor);
+	return t;
+}
+
+/* Read the tensors of the test data set directory 'dataset_dir' (e.g.
+ * "test_add/test_data_set_0"). 'inputs' are for passing to the Graph,
+ * 'outputs' are the buffers for the results, and 'references' the
+ * expected results. */
+inline void load_test_data_set(const std::string &dataset_dir,
+                               std::vector<toC::Tensor*> &inputs,
+                               std::vector<toC::Tensor*> &outputs,
+                               std::vector<toC::Tensor*> &references)
+{
+	using toC::Tensor;
+	int input_number=0;
+	while(true) {
+		std::string partial = dataset_dir + "/input_";
+		Tensor *t = get_input_from_file(partial, input_number);
+		if( t == NULL )
+			break;
+		t->isIO = true;
+		// Don't write the initialization from the onnx2c graph
+		// It is written from the test suite, which is part of "the application",
+		// not the neural net
+		t->initialize = false;
+		t->generate = false;
+		t->isConst=true;
+		if( t->name == "" )
+			t->name = std::string("input_") + std::to_string(input_number);
+	
+		inputs.push_back(t);
+		input_number++;
+	}
+
+	input_number=0;
+	while(true) {
+		std::string partial = dataset_dir + "/output_";
+		Tensor *ref = get_input_from_file(partial, input_number);
+		Tensor *out = get_input_from_file(partial, input_number);
+		if( ref == NULL || out == NULL )
+			break;
+		ref->generate=true;
+		ref->initialize=true;
+		out->generate=true;
+		out->initialize=false;
+		out->isConst=false;
+		// Just in case the network needs to zero-initialize the output buffer (e.g. LSTM)
+		out->data_buffer = NULL;
+		out->isIO = true;
+		if( ref->name == "" ) {
+			ref->name = std::string("output_") + std::to_string(input_number);
+			out->name = std::string("output_") + std::to_string(input_number);
+		}
+
+		references.push_back(ref);
+		outputs.push_back(out);
+		input_number++;
+	}
+}